@@ -4,6 +4,7 @@
 #include <stdbool.h>
 #include <stdio.h>
 #include "devices/timer.h"
+#include "threads/defer.h"
 #include "threads/io.h"
 #include "threads/interrupt.h"
 #include "threads/synch.h"
@@ -73,7 +74,8 @@ struct channel
     struct lock lock;           /* Must acquire to access the controller. */
     bool expecting_interrupt;   /* True if an interrupt is expected, false if
                                    any interrupt would be spurious. */
-    struct semaphore completion_wait;   /* Up'd by interrupt handler. */
+    struct semaphore completion_wait;   /* Up'd by completion_work. */
+    struct defer_work completion_work;  /* Scheduled by interrupt handler. */
 
     struct disk devices[2];     /* The devices on this channel. */
   };
@@ -82,6 +84,11 @@ struct channel
 #define CHANNEL_CNT 2
 static struct channel channels[CHANNEL_CNT];
 
+/* Deferred-work queue for command completions.  The interrupt
+   handler only acknowledges the interrupt; waking the waiting
+   thread happens in this queue's thread. */
+static struct defer_queue disk_defer;
+
 static void reset_channel (struct channel *);
 static bool check_device_type (struct disk *);
 static void identify_ata_device (struct disk *);
@@ -97,6 +104,7 @@ static void select_device (const struct disk *);
 static void select_device_wait (const struct disk *);
 
 static void interrupt_handler (struct intr_frame *);
+static defer_func complete_command;
 
 /* Initialize the disk subsystem and detect disks. */
 void
@@ -104,6 +112,7 @@ disk_init (void)
 {
   size_t chan_no;
 
+  defer_queue_init (&disk_defer, "disk");
   for (chan_no = 0; chan_no < CHANNEL_CNT; chan_no++)
     {
       struct channel *c = &channels[chan_no];
@@ -127,6 +136,7 @@ disk_init (void)
       lock_init (&c->lock);
       c->expecting_interrupt = false;
       sema_init (&c->completion_wait, 0);
+      defer_work_init (&c->completion_work, complete_command, c);
  
       /* Initialize devices. */
       for (dev_no = 0; dev_no < 2; dev_no++)
@@ -558,7 +568,7 @@ interrupt_handler (struct intr_frame *f)
         if (c->expecting_interrupt) 
           {
             inb (reg_status (c));               /* Acknowledge interrupt. */
-            sema_up (&c->completion_wait);      /* Wake up waiter. */
+            defer_schedule (&disk_defer, &c->completion_work);
           }
         else
           printf ("%s: unexpected interrupt\n", c->name);
@@ -568,4 +578,14 @@ interrupt_handler (struct intr_frame *f)
   NOT_REACHED ();
 }
 
+/* Deferred work function for an interrupt on channel C_: wakes
+   up the thread waiting for the command to complete. */
+static void
+complete_command (void *c_)
+{
+  struct channel *c = c_;
+
+  sema_up (&c->completion_wait);
+}
+
 
@@ -1,5 +1,7 @@
 #include "devices/serial.h"
 #include <debug.h>
+#include <stdarg.h>
+#include <stdio.h>
 #include "devices/input.h"
 #include "devices/intq.h"
 #include "devices/timer.h"
@@ -129,6 +131,25 @@ serial_putc (uint8_t byte)
   intr_set_level (old_level);
 }
 
+/* Formats FORMAT like printf() and sends the result to the
+   serial port only, bypassing the VGA console.  Used for long
+   machine-readable dumps.  Output longer than 127 bytes is
+   truncated. */
+void
+serial_printf (const char *format, ...)
+{
+  char buf[128];
+  va_list args;
+  const char *p;
+
+  va_start (args, format);
+  vsnprintf (buf, sizeof buf, format, args);
+  va_end (args);
+
+  for (p = buf; *p != '\0'; p++)
+    serial_putc (*p);
+}
+
 /* Flushes anything in the serial buffer out the port in polling
    mode. */
 void
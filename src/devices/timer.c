@@ -3,8 +3,10 @@
 #include <inttypes.h>
 #include <round.h>
 #include <stdio.h>
+#include "threads/defer.h"
 #include "threads/interrupt.h"
 #include "threads/io.h"
+#include "threads/profile.h"
 #include "threads/synch.h"
 #include "threads/thread.h"
 
@@ -19,29 +21,123 @@
 #error TIMER_FREQ <= 1000 recommended
 #endif
 
+/* 8254 input frequency, in Hz. */
+#define PIT_HZ 1193180
+
+/* 8254 counts per timer tick: input frequency divided by
+   TIMER_FREQ, rounded to nearest. */
+#define PIT_COUNT ((PIT_HZ + TIMER_FREQ / 2) / TIMER_FREQ)
+
 /* Number of timer ticks since OS booted. */
 static int64_t ticks;
 
+/* If true, the idle thread stops the periodic timer interrupt
+   and programs a one-shot interrupt for the next timer deadline
+   instead.  Controlled by kernel command-line option "-nohz". */
+bool timer_nohz;
+
+/* Precomputed loops per tick, or 0 to calibrate at boot. */
+unsigned timer_loops_preset;
+
+/* State of 8254 counter 0.  Normally it is in periodic mode and
+   interrupts at every tick boundary.  To wake a sub-tick sleeper
+   on time, or to skip ticks while idle, it is switched to
+   one-shot mode: it then interrupts once, PIT_SHOT counts after
+   being armed PIT_OFFSET counts into tick `ticks'.  The counter
+   keeps running after a one-shot fires, so the handler measures
+   how late it ran and carries that into the next PIT_OFFSET.
+   The phase of the tick boundaries is thus kept across
+   one-shots, so `ticks' and timer_nanotime() stay exact. */
+static bool pit_oneshot;
+static unsigned pit_offset;
+static unsigned pit_shot;
+
+/* Dynamic-tick state.  While IDLE_NOHZ is true, the idle thread
+   has stopped the periodic tick until the end of tick
+   `ticks' + NOHZ_TICKS.  The longest one-shot the 16-bit counter
+   can hold is NOHZ_TICKS_MAX ticks. */
+#define NOHZ_TICKS_MAX (0xffff / PIT_COUNT)
+static bool idle_nohz;
+static int nohz_ticks;
+
+/* Threads in timer_usleep() or timer_nsleep() for less than a
+   tick, in order of increasing deadline.  They are woken by a
+   one-shot interrupt rather than at the next tick boundary. */
+struct hr_sleeper
+  {
+    struct list_elem elem;      /* Element in hr_sleepers. */
+    int64_t deadline;           /* Time to wake, in ns since boot. */
+    struct semaphore wakeup;    /* "Up"ed to wake the sleeper. */
+  };
+static struct list hr_sleepers;
+
 /* Number of loops per timer tick.
    Initialized by timer_calibrate(). */
 static unsigned loops_per_tick;
 
-// List of all slepping threads
-struct list sleeping_list;
+/* Pending timers are kept in a hierarchical timing wheel, after
+   Varghese and Lauck, "Hashed and Hierarchical Timing Wheels".
+   The root wheel has one slot per tick for the next
+   WHEEL_ROOT_SIZE ticks.  Each outer wheel has WHEEL_SIZE slots,
+   each covering as many ticks as a full turn of the wheel
+   inside it.  When the inner wheels wrap around, the timers in
+   the next slot of the outer wheel are "cascaded" inward.
+
+   Adding or canceling a timer is O(1).  Each timer cascades at
+   most WHEEL_CNT times before it expires, so expiry costs
+   amortized O(1) per timer, independent of how many timers are
+   pending.  Timers further out than the wheels reach are parked
+   in the last slot of the outermost wheel and cascaded again
+   until they come within range. */
+#define WHEEL_ROOT_BITS 8
+#define WHEEL_ROOT_SIZE (1 << WHEEL_ROOT_BITS)
+#define WHEEL_BITS 6
+#define WHEEL_SIZE (1 << WHEEL_BITS)
+#define WHEEL_CNT 3                     /* Number of outer wheels. */
+#define WHEEL_SPAN (WHEEL_ROOT_BITS + WHEEL_CNT * WHEEL_BITS)
+
+static struct list root_wheel[WHEEL_ROOT_SIZE];
+static struct list outer_wheels[WHEEL_CNT][WHEEL_SIZE];
+
+/* Next tick to be processed by the timer wheel.  Every timer
+   that expires before this tick has been moved to
+   expired_timers, if it has not fired yet. */
+static int64_t wheel_ticks;
+
+/* Timers that have expired but whose functions have not run
+   yet.  The timer interrupt handler only moves expired timers
+   here; the functions run later, in the "timer" deferred-work
+   queue's thread. */
+static struct list expired_timers;
+static struct defer_queue timer_defer;
+static struct defer_work timer_work;
 
 static intr_handler_func timer_interrupt;
 static bool too_many_loops (unsigned loops);
 static void busy_wait (int64_t loops);
 static void real_time_sleep (int64_t num, int32_t denom);
-
-static bool cmp_thread_time (const struct list_elem *a, const struct list_elem *b, void *aux);
-// compares to list elements of tzpe sleepthread bz their waking time value, inceaesing order.
-static bool cmp_thread_time (const struct list_elem *a, const struct list_elem *b, void *aux UNUSED)
-{
-  struct sleepthread* first  = list_entry(a, struct sleepthread, elem);
-  struct sleepthread* second = list_entry(b, struct sleepthread, elem);
-  return first->time_of_wake < second->time_of_wake;
-}
+static void wheel_insert (struct timer *);
+static void wheel_advance (void);
+static timer_func wake_sleeper;
+static defer_func run_expired_timers;
+static void pit_periodic (unsigned offset);
+static void pit_one_shot (unsigned offset, unsigned count);
+static void pit_reprogram (unsigned offset);
+static unsigned pit_elapsed (void);
+static bool pit_sample (unsigned *elapsed);
+static unsigned pit_read_count (void);
+static uint8_t pit_read_back (unsigned *count);
+static uint8_t pit_status (void);
+static bool pit_fired (void);
+static bool pit_irq_pending (void);
+static int64_t ticks_to_ns (int64_t);
+static int64_t counts_to_ns (int64_t);
+static void hr_sleep (int64_t ns);
+static void hr_wake (unsigned offset);
+static bool hr_sleeper_less (const struct list_elem *,
+                             const struct list_elem *, void *aux);
+static int64_t wheel_next_deadline (int64_t limit);
+static void timer_advance (int tick_cnt);
 
 /* Sets up the 8254 Programmable Interval Timer (PIT) to
    interrupt PIT_FREQ times per second, and registers the
@@ -49,27 +145,42 @@ static bool cmp_thread_time (const struct list_elem *a, const struct list_elem *
 void
 timer_init (void)
 {
-  /* 8254 input frequency divided by TIMER_FREQ, rounded to
-     nearest. */
-  uint16_t count = (1193180 + TIMER_FREQ / 2) / TIMER_FREQ;
+  int i, j;
 
-  outb (0x43, 0x34);    /* CW: counter 0, LSB then MSB, mode 2, binary. */
-  outb (0x40, count & 0xff);
-  outb (0x40, count >> 8);
+  pit_periodic (0);
 
   intr_register_ext (0x20, timer_interrupt, "8254 Timer");
 
-  // Initialize the list of sleeping threads
-  list_init(&sleeping_list);
+  list_init (&hr_sleepers);
+  list_init (&expired_timers);
+  defer_queue_init (&timer_defer, "timer");
+  defer_work_init (&timer_work, run_expired_timers, NULL);
+  for (i = 0; i < WHEEL_ROOT_SIZE; i++)
+    list_init (&root_wheel[i]);
+  for (i = 0; i < WHEEL_CNT; i++)
+    for (j = 0; j < WHEEL_SIZE; j++)
+      list_init (&outer_wheels[i][j]);
 }
 
-/* Calibrates loops_per_tick, used to implement brief delays. */
+/* Calibrates loops_per_tick, used to implement brief delays.
+   If a value was supplied on the kernel command line, trusts it
+   instead, which saves the several dozen ticks calibration
+   takes. */
 void
 timer_calibrate (void)
 {
   unsigned high_bit, test_bit;
 
   ASSERT (intr_get_level () == INTR_ON);
+  if (timer_loops_preset != 0)
+    {
+      loops_per_tick = timer_loops_preset;
+      printf ("Timer calibration preset:  %'"PRIu64" loops/s "
+              "(%u loops/tick).\n",
+              (uint64_t) loops_per_tick * TIMER_FREQ, loops_per_tick);
+      return;
+    }
+
   printf ("Calibrating timer...  ");
 
   /* Approximate loops_per_tick as the largest power-of-two
@@ -87,7 +198,8 @@ timer_calibrate (void)
     if (!too_many_loops (high_bit | test_bit))
       loops_per_tick |= test_bit;
 
-  printf ("%'"PRIu64" loops/s.\n", (uint64_t) loops_per_tick * TIMER_FREQ);
+  printf ("%'"PRIu64" loops/s (%u loops/tick).\n",
+          (uint64_t) loops_per_tick * TIMER_FREQ, loops_per_tick);
 }
 
 /* Returns the number of timer ticks since the OS booted. */
@@ -113,25 +225,54 @@ timer_elapsed (int64_t then)
 void
 timer_sleep (int64_t ticks)
 {
-  if (ticks <= 0) return;
+  struct semaphore wakeup;
+  struct timer timer;
+  int64_t start;
 
-  int64_t current_time = timer_ticks ();
+  if (ticks <= 0)
+    return;
 
   ASSERT (intr_get_level () == INTR_ON);
 
-  // Disable interrupts, we don't want problems while sleeping the thread
-  enum intr_level old_level = intr_disable ();
+  start = timer_ticks ();
+  sema_init (&wakeup, 0);
+  timer_setup (&timer, wake_sleeper, &wakeup);
+  timer_add (&timer, start + ticks);
+  sema_down (&wakeup);
+}
 
-  // Initialize the sleeping_thread, with it's wake_up value, semaphore and list elem
-  struct sleepthread current_sleepthread;
+/* Timer function for timer_sleep(): wakes up the sleeping
+   thread by "up"ing the semaphore WAKEUP_. */
+static void
+wake_sleeper (void *wakeup_)
+{
+  sema_up (wakeup_);
+}
 
-  current_sleepthread.time_of_wake = ticks + current_time;
-  sema_init(&(current_sleepthread.sema_value), 0);
-  list_insert_ordered(&sleeping_list, &current_sleepthread.elem, cmp_thread_time, NULL);
-  sema_down(&(current_sleepthread.sema_value));
+/* Returns the number of nanoseconds since the OS booted.  The
+   result is monotonic and has the resolution of the 8254 input
+   clock, about 838 ns. */
+int64_t
+timer_nanotime (void)
+{
+  static int64_t last;
+  enum intr_level old_level = intr_disable ();
+  int64_t t = ticks;
+  unsigned elapsed = pit_elapsed ();
+  int64_t ns;
+
+  /* A tick boundary that has passed but whose interrupt is still
+     pending shows up as a counter that has just been reloaded. */
+  if (!pit_oneshot && pit_irq_pending () && elapsed < PIT_COUNT / 2)
+    t++;
+
+  ns = ticks_to_ns (t) + counts_to_ns (elapsed);
+  if (ns < last)
+    ns = last;
+  last = ns;
+  intr_set_level (old_level);
 
-  // We can now re-enable interrupts
-  intr_set_level(old_level);
+  return ns;
 }
 
 /* Suspends execution for approximately MS milliseconds. */
@@ -162,30 +303,527 @@ timer_print_stats (void)
   printf ("Timer: %"PRId64" ticks\n", timer_ticks ());
 }
 
-/* Timer interrupt handler. */
+/* Initializes timer T to call FUNC with AUX when it expires.
+   T is not armed until passed to timer_add(). */
+void
+timer_setup (struct timer *t, timer_func *func, void *aux)
+{
+  ASSERT (t != NULL);
+  ASSERT (func != NULL);
+
+  t->func = func;
+  t->aux = aux;
+  t->expires = 0;
+  t->pending = false;
+}
+
+/* Arms timer T to expire at tick EXPIRES, an absolute time as
+   returned by timer_ticks().  If EXPIRES has already passed, T
+   expires at the next tick.  If T is already pending, it is
+   rescheduled.
+
+   This function may be called from an interrupt handler,
+   including from a timer function. */
+void
+timer_add (struct timer *t, int64_t expires)
+{
+  enum intr_level old_level;
+
+  ASSERT (t != NULL);
+  ASSERT (t->func != NULL);
+
+  old_level = intr_disable ();
+  if (t->pending)
+    list_remove (&t->elem);
+  t->expires = expires;
+  t->pending = true;
+  wheel_insert (t);
+  intr_set_level (old_level);
+}
+
+/* Disarms timer T.  Returns true if T was pending, false if it
+   had already expired or was never armed.
+
+   This function may be called from an interrupt handler. */
+bool
+timer_cancel (struct timer *t)
+{
+  enum intr_level old_level;
+  bool was_pending;
+
+  ASSERT (t != NULL);
+
+  old_level = intr_disable ();
+  was_pending = t->pending;
+  if (was_pending)
+    {
+      list_remove (&t->elem);
+      t->pending = false;
+    }
+  intr_set_level (old_level);
+
+  return was_pending;
+}
+
+/* Returns true if timer T is armed and has not yet expired. */
+bool
+timer_pending (const struct timer *t)
+{
+  ASSERT (t != NULL);
+
+  return t->pending;
+}
+
+/* Called by the idle thread, with interrupts off, just before it
+   halts the CPU.  If dynamic ticks are enabled, replaces the
+   periodic timer interrupt by a one-shot interrupt at the end of
+   the tick in which the next timer expires, up to
+   NOHZ_TICKS_MAX ticks away. */
+void
+timer_idle_enter (void)
+{
+  int64_t deadline;
+  unsigned elapsed;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (!timer_nohz || pit_oneshot || !pit_sample (&elapsed))
+    return;
+
+  deadline = wheel_next_deadline (ticks + NOHZ_TICKS_MAX);
+  if (deadline - ticks <= 1)
+    return;
+
+  idle_nohz = true;
+  nohz_ticks = deadline - ticks;
+  pit_reprogram (elapsed);
+}
+
+/* Called on every external interrupt.  If the idle thread had
+   stopped the periodic tick and the one-shot has not yet fired,
+   accounts for the ticks that went by while the CPU was halted
+   and arranges for the tick to resume at the next tick boundary,
+   so that a thread woken by this interrupt is time-sliced and
+   its timers fire on time. */
+void
+timer_idle_exit (void)
+{
+  unsigned elapsed;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  /* If the one-shot has fired, timer_interrupt() will catch up. */
+  if (!idle_nohz || !pit_sample (&elapsed))
+    return;
+
+  idle_nohz = false;
+  timer_advance (elapsed / PIT_COUNT);
+  pit_reprogram (elapsed % PIT_COUNT);
+}
+
+/* Timer interrupt handler.  Interrupts that end a tick also
+   take a profiler sample of the code interrupted, as saved in F;
+   the one-shots that only wake sub-tick sleepers do not, so as
+   not to bias the profile toward code that sleeps briefly.
+
+   A one-shot is usually handled some time after it fired.  The
+   counter is read to include that latency in ELAPSED, and what
+   is left of it past the last tick boundary becomes the offset
+   of the next one-shot, so that no time is lost. */
 static void
-timer_interrupt (struct intr_frame *args UNUSED)
+timer_interrupt (struct intr_frame *f)
 {
-  // Increase the ticks, unchanged from before
-  ticks++;
-  thread_tick ();
+  unsigned elapsed = pit_oneshot ? pit_elapsed () : PIT_COUNT;
+
+  if (elapsed >= PIT_COUNT)
+    profile_sample (f);
+  idle_nohz = false;
+  timer_advance (elapsed / PIT_COUNT);
+  hr_wake (elapsed % PIT_COUNT);
+  pit_reprogram (elapsed % PIT_COUNT);
+}
 
-  struct list_elem* curr = list_begin(&sleeping_list);
-  while (curr != list_end(&sleeping_list))
-  {
-    // Get an element
-    struct sleepthread* thread = list_entry(curr, struct sleepthread, elem);
+/* Advances the tick count by TICK_CNT, running the scheduler's
+   and the timer wheel's work for each tick. */
+static void
+timer_advance (int tick_cnt)
+{
+  while (tick_cnt-- > 0)
+    {
+      ticks++;
+      thread_tick ();
+
+      while (wheel_ticks <= ticks)
+        wheel_advance ();
+    }
+}
 
-    // If it can be awaken, wake it and remove frome list
-    if (thread->time_of_wake <= timer_ticks())
+/* Programs 8254 counter 0 for the next timer event, given that
+   OFFSET counts of tick `ticks' have already elapsed.  The next
+   event is the earlier of the next tick boundary (or, while
+   idle, the dynamic-tick deadline) and the earliest sub-tick
+   sleeper's deadline.  Returns the counter to periodic mode once
+   the next event is the tick boundary. */
+static void
+pit_reprogram (unsigned offset)
+{
+  unsigned count = PIT_COUNT - offset;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (offset < PIT_COUNT);
+
+  if (idle_nohz)
+    count += (nohz_ticks - 1) * PIT_COUNT;
+
+  if (!list_empty (&hr_sleepers))
+    {
+      struct hr_sleeper *s = list_entry (list_front (&hr_sleepers),
+                                         struct hr_sleeper, elem);
+      int64_t now = ticks_to_ns (ticks) + counts_to_ns (offset);
+      int64_t wait = s->deadline - now;
+      int64_t wait_counts = (wait * PIT_HZ + 999999999) / 1000000000;
+
+      if (wait_counts < 1)
+        wait_counts = 1;
+      if (wait_counts < count)
+        count = wait_counts;
+    }
+
+  if (count == PIT_COUNT - offset && count > 1)
     {
-      sema_up(&thread->sema_value);
-      curr = list_remove(curr);
+      if (pit_oneshot)
+        pit_periodic (offset);
     }
-    // If the current eleement musn't be awaken, we don't look further since list is ordered
-    else break;
-  }
+  else
+    pit_one_shot (offset, count);
+}
+
+/* Programs 8254 counter 0 to interrupt every PIT_COUNT counts,
+   that is, TIMER_FREQ times per second, given that OFFSET counts
+   of tick `ticks' have already elapsed.  The first period is
+   shortened to end on the tick boundary: a count written while
+   the counter runs in mode 2 only takes effect at its next
+   reload. */
+static void
+pit_periodic (unsigned offset)
+{
+  unsigned count = PIT_COUNT - offset;
 
+  ASSERT (count > 1);
+
+  outb (0x43, 0x34);    /* CW: counter 0, LSB then MSB, mode 2, binary. */
+  outb (0x40, count & 0xff);
+  outb (0x40, count >> 8);
+  if (offset != 0)
+    {
+      /* Wait for the first count to be loaded ("null count"
+         clear) before writing the one to reload with. */
+      while ((pit_status () & 0x40) != 0)
+        continue;
+      outb (0x40, PIT_COUNT & 0xff);
+      outb (0x40, PIT_COUNT >> 8);
+    }
+  pit_oneshot = false;
+}
+
+/* Programs 8254 counter 0 to interrupt once, after COUNT counts,
+   given that OFFSET counts of tick `ticks' have already
+   elapsed. */
+static void
+pit_one_shot (unsigned offset, unsigned count)
+{
+  ASSERT (count > 0 && count <= 0xffff);
+
+  outb (0x43, 0x30);    /* CW: counter 0, LSB then MSB, mode 0, binary. */
+  outb (0x40, count & 0xff);
+  outb (0x40, count >> 8);
+  pit_oneshot = true;
+  pit_offset = offset;
+  pit_shot = count;
+}
+
+/* Returns the number of 8254 counts elapsed since the start of
+   tick `ticks'.  While idle with the tick stopped, or once a
+   one-shot has fired, this may span several ticks. */
+static unsigned
+pit_elapsed (void)
+{
+  unsigned count;
+
+  if (!pit_oneshot)
+    {
+      count = pit_read_count ();
+      return count > 0 && count <= PIT_COUNT ? PIT_COUNT - count : 0;
+    }
+  else if ((pit_read_back (&count) & 0x80) != 0)
+    {
+      /* Past terminal count, a mode-0 counter wraps around to
+         0xffff and keeps counting down, so COUNT tells how long
+         ago the one-shot fired. */
+      return pit_offset + pit_shot + ((0x10000 - count) & 0xffff);
+    }
+  else
+    return pit_offset + pit_shot - (count <= pit_shot ? count : pit_shot);
+}
+
+/* Stores in *ELAPSED the number of 8254 counts elapsed since
+   the start of tick `ticks', for reprogramming the counter.
+   Returns false, and the sample must not be used, if a timer
+   interrupt is pending: its handler has yet to account for the
+   time up to it, and will reprogram the counter itself.  The
+   check for a pending interrupt follows the read of the counter,
+   so a counter that fires or reloads between the two is caught
+   too.  Interrupts must be off. */
+static bool
+pit_sample (unsigned *elapsed)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  *elapsed = pit_elapsed ();
+  return !pit_irq_pending ();
+}
+
+/* Returns the current value of 8254 counter 0. */
+static unsigned
+pit_read_count (void)
+{
+  uint8_t lsb, msb;
+
+  outb (0x43, 0x00);    /* Counter latch command for counter 0. */
+  lsb = inb (0x40);
+  msb = inb (0x40);
+  return lsb | (msb << 8);
+}
+
+/* Latches the status and the count of counter 0 together with
+   the read-back command, stores the count in *COUNT, and returns
+   the status.  Bit 7 of the status is the OUT pin, so the count
+   and whether a one-shot has fired are consistent. */
+static uint8_t
+pit_read_back (unsigned *count)
+{
+  uint8_t status, lsb, msb;
+
+  outb (0x43, 0xc2);    /* Read-back: count and status, counter 0. */
+  status = inb (0x40);
+  lsb = inb (0x40);
+  msb = inb (0x40);
+  *count = lsb | (msb << 8);
+  return status;
+}
+
+/* Returns the status of counter 0, read with the read-back
+   command.  Bit 7 is its OUT pin, bit 6 is set until a count
+   just written has been loaded into the counter. */
+static uint8_t
+pit_status (void)
+{
+  outb (0x43, 0xe2);    /* Read-back: status only, counter 0. */
+  return inb (0x40);
+}
+
+/* Returns true if counter 0, in one-shot mode, has reached its
+   terminal count, by checking its OUT pin. */
+static bool
+pit_fired (void)
+{
+  return (pit_status () & 0x80) != 0;
+}
+
+/* Returns true if a timer interrupt is waiting to be delivered,
+   that is, if IRQ 0 is set in the master PIC's interrupt request
+   register.  See [8259A]. */
+static bool
+pit_irq_pending (void)
+{
+  if (pit_oneshot)
+    return pit_fired ();
+  outb (0x20, 0x0a);    /* OCW3: read IRR on next read. */
+  return (inb (0x20) & 0x01) != 0;
+}
+
+/* Returns the time at which tick T began, in ns since boot. */
+static int64_t
+ticks_to_ns (int64_t t)
+{
+  return (t / TIMER_FREQ * 1000000000
+          + t % TIMER_FREQ * 1000000000 / TIMER_FREQ);
+}
+
+/* Converts COUNTS 8254 input clock periods to ns. */
+static int64_t
+counts_to_ns (int64_t counts)
+{
+  return counts * 1000000000 / PIT_HZ;
+}
+
+/* Sleeps for NS nanoseconds, less than one timer tick, without
+   busy-waiting: the thread blocks and is woken by a one-shot
+   timer interrupt at its deadline. */
+static void
+hr_sleep (int64_t ns)
+{
+  struct hr_sleeper s;
+  enum intr_level old_level;
+  unsigned elapsed;
+
+  old_level = intr_disable ();
+  s.deadline = timer_nanotime () + ns;
+  sema_init (&s.wakeup, 0);
+  list_insert_ordered (&hr_sleepers, &s.elem, hr_sleeper_less, NULL);
+
+  /* If a timer interrupt is already pending, it will program the
+     one-shot for us. */
+  if (pit_sample (&elapsed))
+    pit_reprogram (elapsed);
+
+  sema_down (&s.wakeup);
+  intr_set_level (old_level);
+}
+
+/* Wakes every sub-tick sleeper whose deadline has passed, given
+   that OFFSET counts of tick `ticks' have elapsed.  A sleeper
+   due within one count is woken now too, to absorb rounding. */
+static void
+hr_wake (unsigned offset)
+{
+  int64_t now = ticks_to_ns (ticks) + counts_to_ns (offset + 1);
+
+  while (!list_empty (&hr_sleepers))
+    {
+      struct hr_sleeper *s = list_entry (list_front (&hr_sleepers),
+                                         struct hr_sleeper, elem);
+      if (s->deadline > now)
+        break;
+      list_pop_front (&hr_sleepers);
+      sema_up (&s->wakeup);
+    }
+}
+
+/* Orders sub-tick sleepers by increasing deadline. */
+static bool
+hr_sleeper_less (const struct list_elem *a, const struct list_elem *b,
+                 void *aux UNUSED)
+{
+  return (list_entry (a, struct hr_sleeper, elem)->deadline
+          < list_entry (b, struct hr_sleeper, elem)->deadline);
+}
+
+/* Puts pending timer T into the wheel slot that covers its
+   expiry time, relative to wheel_ticks. */
+static void
+wheel_insert (struct timer *t)
+{
+  int64_t expires = t->expires;
+  int64_t delta = expires - wheel_ticks;
+  struct list *slot;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (delta < 0)
+    {
+      /* Already expired: fire on the next tick processed. */
+      slot = &root_wheel[wheel_ticks & (WHEEL_ROOT_SIZE - 1)];
+    }
+  else if (delta < WHEEL_ROOT_SIZE)
+    slot = &root_wheel[expires & (WHEEL_ROOT_SIZE - 1)];
+  else
+    {
+      int level;
+
+      /* Out of range: park as far out as the wheels reach. */
+      if (delta >= (int64_t) 1 << WHEEL_SPAN)
+        expires = wheel_ticks + ((int64_t) 1 << WHEEL_SPAN) - 1;
+
+      for (level = 0; level < WHEEL_CNT - 1; level++)
+        if (delta < (int64_t) 1 << (WHEEL_ROOT_BITS
+                                    + (level + 1) * WHEEL_BITS))
+          break;
+      slot = &outer_wheels[level][(expires >> (WHEEL_ROOT_BITS
+                                               + level * WHEEL_BITS))
+                                  & (WHEEL_SIZE - 1)];
+    }
+  list_push_back (slot, &t->elem);
+}
+
+/* Returns the first tick after `ticks', but no later than LIMIT,
+   at which the timer wheel has work to do: a root slot holding
+   timers, or a wrap-around of the root wheel, which may cascade
+   timers from the outer wheels. */
+static int64_t
+wheel_next_deadline (int64_t limit)
+{
+  int64_t t;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  for (t = wheel_ticks; t < limit; t++)
+    {
+      int index = t & (WHEEL_ROOT_SIZE - 1);
+      if (index == 0 || !list_empty (&root_wheel[index]))
+        return t;
+    }
+  return limit;
+}
+
+/* Moves every timer in outer wheel LEVEL's slot for the current
+   turn into an inner wheel.  Returns the slot's index, so that
+   the caller can tell whether this wheel has also wrapped
+   around. */
+static int
+wheel_cascade (int level)
+{
+  int index = (wheel_ticks >> (WHEEL_ROOT_BITS + level * WHEEL_BITS))
+              & (WHEEL_SIZE - 1);
+  struct list *slot = &outer_wheels[level][index];
+
+  while (!list_empty (slot))
+    wheel_insert (list_entry (list_pop_front (slot), struct timer, elem));
+  return index;
+}
+
+/* Processes tick wheel_ticks: cascades timers inward if the root
+   wheel wraps around, then moves every timer in the root slot
+   for this tick to expired_timers, to be fired by
+   run_expired_timers(). */
+static void
+wheel_advance (void)
+{
+  int index = wheel_ticks & (WHEEL_ROOT_SIZE - 1);
+  int level;
+
+  if (index == 0)
+    for (level = 0; level < WHEEL_CNT; level++)
+      if (wheel_cascade (level) != 0)
+        break;
+  wheel_ticks++;
+
+  if (!list_empty (&root_wheel[index]))
+    {
+      list_splice (list_end (&expired_timers),
+                   list_begin (&root_wheel[index]),
+                   list_end (&root_wheel[index]));
+      defer_schedule (&timer_defer, &timer_work);
+    }
+}
+
+/* Deferred work function that fires the timers in
+   expired_timers, in order of expiry.  A timer stays pending
+   until its function is called, so it may still be canceled or
+   re-armed while it waits here. */
+static void
+run_expired_timers (void *aux UNUSED)
+{
+  enum intr_level old_level = intr_disable ();
+
+  while (!list_empty (&expired_timers))
+    {
+      struct timer *t = list_entry (list_pop_front (&expired_timers),
+                                    struct timer, elem);
+      t->pending = false;
+      t->func (t->aux);
+    }
+  intr_set_level (old_level);
 }
 
 /* Returns true if LOOPS iterations waits for more than one timer
@@ -241,12 +879,13 @@ real_time_sleep (int64_t num, int32_t denom)
          processes. */
       timer_sleep (ticks);
     }
-  else
+  else if (num > 0)
     {
-      /* Otherwise, use a busy-wait loop for more accurate
-         sub-tick timing.  We scale the numerator and denominator
-         down by 1000 to avoid the possibility of overflow. */
+      /* Otherwise, block until a one-shot timer interrupt for
+         more accurate sub-tick timing.  We scale the numerator
+         and denominator down by 1000 to avoid the possibility of
+         overflow. */
       ASSERT (denom % 1000 == 0);
-      busy_wait (loops_per_tick * num / 1000 * TIMER_FREQ / (denom / 1000));
+      hr_sleep (num * 1000000 / (denom / 1000));
     }
 }
@@ -1,17 +1,29 @@
 #ifndef DEVICES_TIMER_H
 #define DEVICES_TIMER_H
 
+#include <list.h>
 #include <round.h>
+#include <stdbool.h>
 #include <stdint.h>
 
 /* Number of timer interrupts per second. */
 #define TIMER_FREQ 100
 
+/* If true, stop the periodic tick while idle.
+   Controlled by kernel command-line option "-nohz". */
+extern bool timer_nohz;
+
+/* If nonzero, used as the number of busy-wait loops per timer
+   tick instead of measuring it in timer_calibrate().  Controlled
+   by kernel command-line option "-lpt=LOOPS". */
+extern unsigned timer_loops_preset;
+
 void timer_init (void);
 void timer_calibrate (void);
 
 int64_t timer_ticks (void);
 int64_t timer_elapsed (int64_t);
+int64_t timer_nanotime (void);
 
 void timer_sleep (int64_t ticks);
 void timer_msleep (int64_t milliseconds);
@@ -20,4 +32,30 @@ void timer_nsleep (int64_t nanoseconds);
 
 void timer_print_stats (void);
 
+void timer_idle_enter (void);
+void timer_idle_exit (void);
+
+/* Function called when a timer expires.  Runs soon after the
+   timer interrupt, in the "timer" deferred-work thread, with
+   interrupts off, so it must not sleep. */
+typedef void timer_func (void *aux);
+
+/* A one-shot kernel timer.  Initialize with timer_setup(), then
+   arm with timer_add() and disarm with timer_cancel().  The
+   owner keeps the storage; it must not be freed while the timer
+   is pending. */
+struct timer
+  {
+    struct list_elem elem;      /* Element in a timer wheel slot. */
+    int64_t expires;            /* Tick at which to call FUNC. */
+    timer_func *func;           /* Function to call on expiry. */
+    void *aux;                  /* Auxiliary data for FUNC. */
+    bool pending;               /* Armed and not yet expired? */
+  };
+
+void timer_setup (struct timer *, timer_func *, void *aux);
+void timer_add (struct timer *, int64_t expires);
+bool timer_cancel (struct timer *);
+bool timer_pending (const struct timer *);
+
 #endif /* devices/timer.h */
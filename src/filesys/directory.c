@@ -4,7 +4,7 @@
 #include <list.h>
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
-#include "threads/malloc.h"
+#include "threads/slab.h"
 #include "threads/synch.h"
 
 /* A directory. */
@@ -21,15 +21,28 @@ struct dir_entry
     char name[NAME_MAX + 1];            /* Null terminated file name. */
     bool in_use;                        /* In use or free? */
   };
-struct lock dir_lock;
-/* Creates a directory with space for ENTRY_CNT entries in the
-   given SECTOR.  Returns true if successful, false on failure. */
-   
+/* Held for reading to search directories and for writing to
+   change them. */
+struct rwlock dir_lock;
+
+/* Cache of open directories. */
+static struct kmem_cache dir_cache;
+
+/* Initializes the directory module. */
+void
+dir_init (void)
+{
+  kmem_cache_init (&dir_cache, "dir", sizeof (struct dir), NULL);
+}
+
 // Used by filesys init to init the dir_lock
-struct lock* get_dir_lock()
+struct rwlock* get_dir_lock(void)
 {
 	return &dir_lock;
 }
+
+/* Creates a directory with space for ENTRY_CNT entries in the
+   given SECTOR.  Returns true if successful, false on failure. */
 bool
 dir_create (disk_sector_t sector, size_t entry_cnt) 
 {
@@ -41,24 +54,17 @@ dir_create (disk_sector_t sector, size_t entry_cnt)
 struct dir *
 dir_open (struct inode *inode) 
 {
-  lock_acquire(&dir_lock);
-  
-  struct dir *dir = calloc (1, sizeof *dir);
+  struct dir *dir = kmem_cache_alloc (&dir_cache);
   if (inode != NULL && dir != NULL)
     {
-	  	
       dir->inode = inode;
       dir->pos = 0;
-      lock_release(&dir_lock);
-      
       return dir;
     }
   else
     {
       inode_close (inode);
-      free (dir);
-      lock_release(&dir_lock);
-      
+      kmem_cache_free (&dir_cache, dir);
       return NULL; 
     }
 }
@@ -83,13 +89,11 @@ dir_reopen (struct dir *dir)
 void
 dir_close (struct dir *dir) 
 {
-  lock_acquire(&dir_lock);
   if (dir != NULL)
     {
       inode_close (dir->inode);
-      free (dir);
+      kmem_cache_free (&dir_cache, dir);
     }
-  lock_release(&dir_lock);
 }
 
 /* Returns the inode encapsulated by DIR. */
@@ -135,7 +139,7 @@ bool
 dir_lookup (const struct dir *dir, const char *name,
             struct inode **inode) 
 {
-  lock_acquire(&dir_lock);
+  rwlock_acquire_read(&dir_lock);
   struct dir_entry e;
 
   ASSERT (dir != NULL);
@@ -146,7 +150,7 @@ dir_lookup (const struct dir *dir, const char *name,
   else
     *inode = NULL;
 
-  lock_release(&dir_lock);
+  rwlock_release_read(&dir_lock);
   return *inode != NULL;
 }
 
@@ -171,7 +175,7 @@ dir_add (struct dir *dir, const char *name, disk_sector_t inode_sector)
   if (*name == '\0' || strlen (name) > NAME_MAX)
     return false;
     
-  lock_acquire(&dir_lock);
+  rwlock_acquire_write(&dir_lock);
   /* Check that NAME is not in use. */
   if (lookup (dir, name, NULL, NULL))
     goto done;
@@ -195,7 +199,7 @@ dir_add (struct dir *dir, const char *name, disk_sector_t inode_sector)
   success = inode_write_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
 
  done:
-  lock_release(&dir_lock);
+  rwlock_release_write(&dir_lock);
   return success;
 }
 
@@ -213,7 +217,7 @@ dir_remove (struct dir *dir, const char *name)
   ASSERT (dir != NULL);
   ASSERT (name != NULL);
   
-  lock_acquire(&dir_lock);
+  rwlock_acquire_write(&dir_lock);
   
   /* Find directory entry. */
   if (!lookup (dir, name, &e, &ofs))
@@ -235,7 +239,7 @@ dir_remove (struct dir *dir, const char *name)
 
  done:
   inode_close (inode);
-  lock_release(&dir_lock);
+  rwlock_release_write(&dir_lock);
   return success;
 }
 
@@ -246,17 +250,17 @@ bool
 dir_readdir (struct dir *dir, char name[NAME_MAX + 1])
 {
   struct dir_entry e;
-  lock_acquire(&dir_lock);
+  rwlock_acquire_read(&dir_lock);
   while (inode_read_at (dir->inode, &e, sizeof e, dir->pos) == sizeof e) 
     {
       dir->pos += sizeof e;
       if (e.in_use)
         {
           strlcpy (name, e.name, NAME_MAX + 1);
-          lock_release(&dir_lock);
+          rwlock_release_read(&dir_lock);
           return true;
         } 
     }
-  lock_release(&dir_lock);
+  rwlock_release_read(&dir_lock);
   return false;
 }
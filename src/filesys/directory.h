@@ -13,7 +13,8 @@
 
 struct inode;
 
-struct lock* get_dir_lock();
+void dir_init (void);
+struct rwlock* get_dir_lock(void);
 /* Opening and closing directories. */
 bool dir_create (disk_sector_t sector, size_t entry_cnt);
 struct dir *dir_open (struct inode *);
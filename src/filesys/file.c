@@ -1,7 +1,7 @@
 #include "filesys/file.h"
 #include <debug.h>
 #include "filesys/inode.h"
-#include "threads/malloc.h"
+#include "threads/slab.h"
 #include "threads/synch.h"
 #include <stdio.h>
 
@@ -14,13 +14,23 @@ struct file
 
   };
 
+/* Cache of open files. */
+static struct kmem_cache file_cache;
+
+/* Initializes the file module. */
+void
+file_init (void) 
+{
+  kmem_cache_init (&file_cache, "file", sizeof (struct file), NULL);
+}
+
 /* Opens a file for the given INODE, of which it takes ownership,
    and returns the new file.  Returns a null pointer if an
    allocation fails or if INODE is null. */
 struct file *
 file_open (struct inode *inode) 
 {
-  struct file *file = calloc (1, sizeof *file);
+  struct file *file = kmem_cache_alloc (&file_cache);
   if (inode != NULL && file != NULL) 
     {
       if (!inode_removed(inode)) // Check that the file hasn't been marked as removed
@@ -39,7 +49,7 @@ file_open (struct inode *inode)
   else
     {
       inode_close (inode);
-      free (file);
+      kmem_cache_free (&file_cache, file);
       return NULL; 
     }
 }
@@ -60,7 +70,7 @@ file_close (struct file *file)
     {
       file_allow_write (file);
       inode_close (file->inode);
-      free (file); 
+      kmem_cache_free (&file_cache, file);
     }
 }
 
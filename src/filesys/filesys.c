@@ -18,12 +18,14 @@ static void do_format (void);
 void
 filesys_init (bool format) 
 {
-  lock_init(get_dir_lock()); // Initialize the directory lock
+  rwlock_init(get_dir_lock(), RWLOCK_FAIR); // Initialize the directory lock
   filesys_disk = disk_get (0, 1);
   if (filesys_disk == NULL)
     PANIC ("hd0:1 (hdb) not present, file system initialization failed");
 
   inode_init ();
+  file_init ();
+  dir_init ();
   free_map_init ();
 
   if (format) 
@@ -6,6 +6,7 @@
 #include "filesys/filesys.h"
 #include "filesys/free-map.h"
 #include "threads/malloc.h"
+#include "threads/slab.h"
 #include "threads/synch.h"
 
 /* Identifies an inode. */
@@ -39,9 +40,8 @@ struct inode
     int deny_write_cnt;                 /* 0: writes ok, >0: deny writes. */
     struct inode_disk data;             /* Inode content. */
 
-    int read_count;                     /* Number of reader using the inode */
-    struct lock inode_lock;             /* General purpose lock, used for any operation on the inode */
-    struct semaphore write_sema;        /* Semaphore to handle the writers */
+    struct lock inode_lock;             /* Protects the counters above. */
+    struct rwlock data_lock;            /* Held to read or write data. */
 
   };
  
@@ -65,12 +65,27 @@ byte_to_sector (const struct inode *inode, off_t pos)
 static struct list open_inodes;
 struct lock general_lock;
 
+/* Cache of in-memory inodes. */
+static struct kmem_cache inode_cache;
+
+/* Constructs an in-memory inode in INODE_.  Nothing holds or
+   waits for an inode's locks by the time its last opener closes
+   it, so they only need to be initialized once. */
+static void
+inode_ctor (void *inode_)
+{
+  struct inode *inode = inode_;
+  lock_init (&inode->inode_lock);
+  rwlock_init (&inode->data_lock, RWLOCK_FAIR);
+}
+
 /* Initializes the inode module. */
 void
 inode_init (void) 
 {
   lock_init(&general_lock);
   list_init(&open_inodes);
+  kmem_cache_init (&inode_cache, "inode", sizeof (struct inode), inode_ctor);
 }
 
 /* Initializes an inode with LENGTH bytes of data and
@@ -144,7 +159,7 @@ inode_open (disk_sector_t sector)
     }
 
   /* Allocate memory. */
-  inode = malloc (sizeof *inode);
+  inode = kmem_cache_alloc (&inode_cache);
   if (inode == NULL)
   {
 	lock_release(&general_lock);  
@@ -158,12 +173,6 @@ inode_open (disk_sector_t sector)
   inode->deny_write_cnt = 0;
   inode->removed = false;
 
-
-  inode->read_count = 0;
-  lock_init(&inode->inode_lock);
-  sema_init(&inode->write_sema, 1);
-  
-
   disk_read (filesys_disk, inode->sector, &inode->data);
   lock_release(&general_lock);
   return inode;
@@ -215,7 +224,7 @@ inode_close (struct inode *inode)
                             bytes_to_sectors (inode->data.length)); 
         }
 
-      free (inode); 
+      kmem_cache_free (&inode_cache, inode);
     }
   lock_release(&general_lock);
 }
@@ -237,14 +246,7 @@ inode_remove (struct inode *inode)
 off_t
 inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset) 
 {
-
-  lock_acquire(&inode->inode_lock);
-  inode->read_count ++;
-  if (inode->read_count == 1) // First to read
-  {
-    sema_down(&inode->write_sema); // Lock so nobody can write
-  }
-  lock_release(&inode->inode_lock);
+  rwlock_acquire_read(&inode->data_lock);
 
   uint8_t *buffer = buffer_;
   off_t bytes_read = 0;
@@ -291,14 +293,7 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
       bytes_read += chunk_size;
     }
   free (bounce);
-  lock_acquire(&inode->inode_lock);
-  inode->read_count --;
-  if (inode->read_count == 0)
-  {
-    sema_up(&inode->write_sema);
-  }
-
-  lock_release(&inode->inode_lock);
+  rwlock_release_read(&inode->data_lock);
   return bytes_read;
 }
 
@@ -311,14 +306,14 @@ off_t
 inode_write_at (struct inode *inode, const void *buffer_, off_t size,
                 off_t offset) 
 {
-  sema_down(&inode->write_sema);
+  rwlock_acquire_write(&inode->data_lock);
   const uint8_t *buffer = buffer_;
   off_t bytes_written = 0;
   uint8_t *bounce = NULL;
 
   if (inode->deny_write_cnt)
   {
-    sema_up(&inode->write_sema);
+    rwlock_release_write(&inode->data_lock);
     return 0;
   }
   while (size > 0) 
@@ -369,7 +364,7 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
       bytes_written += chunk_size;
     }
   free (bounce);
-  sema_up(&inode->write_sema);
+  rwlock_release_write(&inode->data_lock);
   return bytes_written;
 }
 
@@ -64,6 +64,7 @@ struct hash
     hash_hash_func *hash;       /* Hash function. */
     hash_less_func *less;       /* Comparison function. */
     void *aux;                  /* Auxiliary data for `hash' and `less'. */
+    bool fixed;                 /* Caller's buckets, never resized? */
   };
 
 /* A hash table iterator. */
@@ -76,6 +77,8 @@ struct hash_iterator
 
 /* Basic life cycle. */
 bool hash_init (struct hash *, hash_hash_func *, hash_less_func *, void *aux);
+void hash_init_fixed (struct hash *, struct list *buckets, size_t bucket_cnt,
+                      hash_hash_func *, hash_less_func *, void *aux);
 void hash_clear (struct hash *, hash_action_func *);
 void hash_destroy (struct hash *, hash_action_func *);
 
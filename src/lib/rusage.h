@@ -0,0 +1,21 @@
+#ifndef __LIB_RUSAGE_H
+#define __LIB_RUSAGE_H
+
+#include <stdint.h>
+
+/* CPU and scheduling statistics for a thread, as returned by the
+   getrusage() system call.  READY_TICKS and the wakeup figures
+   are only gathered with the kernel option -schedstat. */
+struct rusage
+  {
+    int64_t run_ticks;            /* Timer ticks spent running. */
+    int64_t ready_ticks;          /* Timer ticks spent ready to run. */
+    int64_t voluntary_switches;   /* Switched out by blocking or exiting. */
+    int64_t involuntary_switches; /* Switched out while still ready. */
+    int64_t blocks;               /* Number of times blocked. */
+    int64_t wakeups;              /* Times run after being unblocked. */
+    int64_t wakeup_latency_ns;    /* Total time from unblock to run. */
+    int64_t wakeup_latency_max_ns; /* Longest time from unblock to run. */
+  };
+
+#endif /* lib/rusage.h */
@@ -3,6 +3,7 @@
 
 #include <stdbool.h>
 #include <debug.h>
+#include <rusage.h>
 
 /* Process identifier. */
 typedef int pid_t;
@@ -45,4 +46,9 @@ bool readdir (int fd, char name[READDIR_MAX_LEN + 1]);
 bool isdir (int fd);
 int inumber (int fd);
 
+/* Local extensions. */
+void getrusage (struct rusage *);
+int futex_wait (int *addr, int expected);
+int futex_wake (int *addr, int n);
+
 #endif /* lib/user/syscall.h */
@@ -0,0 +1,201 @@
+/* Measures the throughput of the bounded buffer against the
+   SynchList, passing ITEM_CNT integers from a producer thread to
+   a consumer thread of equal priority.  The bounded buffer is
+   run locked and lock-free (single producer and consumer), each
+   moving one item or BATCH items per call.  The SynchList is run
+   as is and bounded to BUFFER_SIZE elements, moving BATCH
+   intrusive elements per call.
+
+   The timings vary from run to run, so bb-bench.ck masks them
+   and checks only that every item arrived, in order. */
+
+#include <stdio.h>
+#include <list.h>
+#include "tests/threads/tests.h"
+#include "threads/boundedbuffer.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/synchlist.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define ITEM_CNT 20000          /* Items passed per run. */
+#define BUFFER_SIZE 64          /* Bounded buffer capacity. */
+#define BATCH 16                /* Items per bb_*_n() call. */
+
+static struct bounded_buffer bb;
+static struct SynchList sl;
+static struct semaphore producer_done;
+
+/* An item passed intrusively through the SynchList. */
+struct sl_item
+  {
+    struct list_elem elem;
+    int value;
+  };
+static struct sl_item *sl_items;
+
+/* Producers. */
+static void
+bb_producer (void *aux UNUSED) 
+{
+  int i;
+
+  for (i = 0; i < ITEM_CNT; i++)
+    bb_write (&bb, i);
+  sema_up (&producer_done);
+}
+
+static void
+bb_batch_producer (void *aux UNUSED) 
+{
+  int values[BATCH];
+  int i, j;
+
+  for (i = 0; i < ITEM_CNT; i += BATCH)
+    {
+      for (j = 0; j < BATCH; j++)
+        values[j] = i + j;
+      bb_write_n (&bb, values, BATCH);
+    }
+  sema_up (&producer_done);
+}
+
+static void
+sl_producer (void *aux UNUSED) 
+{
+  int i;
+
+  for (i = 0; i < ITEM_CNT; i++)
+    sl_append (&sl, (void *) i);
+  sema_up (&producer_done);
+}
+
+static void
+sl_batch_producer (void *aux UNUSED) 
+{
+  struct list batch;
+  int i, j;
+
+  list_init (&batch);
+  for (i = 0; i < ITEM_CNT; i += BATCH)
+    {
+      for (j = 0; j < BATCH; j++)
+        {
+          sl_items[i + j].value = i + j;
+          list_push_back (&batch, &sl_items[i + j].elem);
+        }
+      sl_append_many (&sl, &batch);
+    }
+  sema_up (&producer_done);
+}
+
+/* Consumers.  Each returns the number of items out of order. */
+static int
+bb_consume (void) 
+{
+  int errors = 0;
+  int i;
+
+  for (i = 0; i < ITEM_CNT; i++)
+    errors += bb_read (&bb) != i;
+  return errors;
+}
+
+static int
+bb_batch_consume (void) 
+{
+  int values[BATCH];
+  int errors = 0;
+  int i, j;
+
+  for (i = 0; i < ITEM_CNT; i += BATCH)
+    {
+      bb_read_n (&bb, values, BATCH);
+      for (j = 0; j < BATCH; j++)
+        errors += values[j] != i + j;
+    }
+  return errors;
+}
+
+static int
+sl_consume (void) 
+{
+  int errors = 0;
+  int i;
+
+  for (i = 0; i < ITEM_CNT; i++)
+    errors += (int) sl_remove (&sl) != i;
+  return errors;
+}
+
+static int
+sl_batch_consume (void) 
+{
+  struct list batch;
+  int errors = 0;
+  int i = 0;
+
+  list_init (&batch);
+  while (i < ITEM_CNT)
+    {
+      sl_remove_many (&sl, &batch, BATCH);
+      while (!list_empty (&batch))
+        {
+          struct sl_item *item = list_entry (list_pop_front (&batch),
+                                             struct sl_item, elem);
+          errors += item->value != i++;
+        }
+    }
+  return errors;
+}
+
+/* Runs PRODUCER in a new thread and CONSUME in this one, and
+   reports the throughput under NAME. */
+static void
+run (const char *name, thread_func *producer, int (*consume) (void)) 
+{
+  int64_t start, elapsed;
+  int errors;
+
+  start = timer_nanotime ();
+  thread_create (name, PRI_DEFAULT, producer, NULL);
+  errors = consume ();
+  sema_down (&producer_done);
+  elapsed = timer_nanotime () - start;
+
+  if (errors != 0)
+    fail ("%s: %d items out of order", name, errors);
+  msg ("%s: %d items in %lld us (%lld items/ms)", name, ITEM_CNT,
+       elapsed / 1000, elapsed > 0 ? ITEM_CNT * 1000000LL / elapsed : 0);
+}
+
+void
+test_bb_bench (void) 
+{
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  sema_init (&producer_done, 0);
+
+  sl_init (&sl);
+  run ("synchlist", sl_producer, sl_consume);
+  sl_destroy (&sl);
+
+  sl_items = malloc (ITEM_CNT * sizeof *sl_items);
+  ASSERT (sl_items != NULL);
+  sl_init_bounded (&sl, BUFFER_SIZE);
+  run ("synchlist bounded batched", sl_batch_producer, sl_batch_consume);
+  sl_destroy (&sl);
+  free (sl_items);
+
+  bb_init (&bb, BUFFER_SIZE);
+  run ("bb locked", bb_producer, bb_consume);
+  run ("bb locked batched", bb_batch_producer, bb_batch_consume);
+  bb_destroy (&bb);
+
+  bb_init_spsc (&bb, BUFFER_SIZE);
+  run ("bb spsc", bb_producer, bb_consume);
+  run ("bb spsc batched", bb_batch_producer, bb_batch_consume);
+  bb_destroy (&bb);
+}
@@ -0,0 +1,23 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+
+# Timings vary from run to run.
+s/ in \d+ us \(\d+ items\/ms\)$/ in # us (# items\/ms)/ foreach @output;
+
+compare_output ("run", \@output, [<<'EOF']);
+(bb-bench) begin
+(bb-bench) synchlist: 20000 items in # us (# items/ms)
+(bb-bench) synchlist bounded batched: 20000 items in # us (# items/ms)
+(bb-bench) bb locked: 20000 items in # us (# items/ms)
+(bb-bench) bb locked batched: 20000 items in # us (# items/ms)
+(bb-bench) bb spsc: 20000 items in # us (# items/ms)
+(bb-bench) bb spsc batched: 20000 items in # us (# items/ms)
+(bb-bench) end
+EOF
+pass;
@@ -0,0 +1,116 @@
+/* Measures malloc() and free() throughput, in operations per
+   timer tick, with the allocator tuned as it used to be (no
+   empty arenas kept, no magazines) and as configured.
+
+   "ping-pong" allocates and frees a single block, so that with
+   no empty arenas kept every free() gives the arena back to the
+   page allocator and every malloc() gets a new one.  "batch"
+   allocates BATCH blocks of mixed sizes, then frees them.
+
+   The timings vary from run to run, so malloc-bench.ck masks
+   them.  What is checked is that the allocations succeed and
+   that, once an empty arena is kept, "ping-pong" no longer
+   obtains a new arena from the page allocator each round. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/malloc.h"
+#include "devices/timer.h"
+
+#define RUN_TICKS 20            /* Length of each run. */
+#define BATCH 64                /* Blocks per round of "batch". */
+
+/* Allocates and frees one block.  Returns the number of malloc()
+   and free() calls made. */
+static int
+ping_pong (void)
+{
+  void *p = malloc (100);
+  if (p == NULL)
+    fail ("out of memory");
+  free (p);
+  return 2;
+}
+
+/* Allocates BATCH blocks of various sizes, then frees them.
+   Returns the number of malloc() and free() calls made. */
+static int
+batch (void)
+{
+  void *blocks[BATCH];
+  int i;
+
+  for (i = 0; i < BATCH; i++)
+    {
+      blocks[i] = malloc (16 << (i % 6));
+      if (blocks[i] == NULL)
+        fail ("out of memory");
+    }
+  for (i = 0; i < BATCH; i++)
+    free (blocks[i]);
+  return 2 * BATCH;
+}
+
+/* Runs ROUND for RUN_TICKS timer ticks with malloc tuned to keep
+   EMPTY_ARENAS empty arenas and MAGAZINE_SIZE blocks per
+   magazine, and prints the operations per tick.  Returns the
+   number of arenas malloc obtained from the page allocator
+   during the run. */
+static long long
+run (const char *name, int (*round) (void),
+     size_t empty_arenas, size_t magazine_size)
+{
+  size_t old_empty = malloc_empty_arenas;
+  size_t old_magazine = malloc_magazine_size;
+  long long ops = 0;
+  long long creates;
+  int64_t start;
+
+  /* Retune, then drain the magazines, so that blocks cached
+     under an earlier setting do not skew this run. */
+  malloc_empty_arenas = empty_arenas;
+  malloc_magazine_size = magazine_size;
+  malloc_drain ();
+
+  /* Start on a tick boundary. */
+  start = timer_ticks ();
+  while (timer_ticks () == start)
+    continue;
+
+  creates = malloc_arena_creates ();
+  start = timer_ticks ();
+  while (timer_elapsed (start) < RUN_TICKS)
+    ops += round ();
+  creates = malloc_arena_creates () - creates;
+
+  malloc_empty_arenas = old_empty;
+  malloc_magazine_size = old_magazine;
+  malloc_drain ();
+
+  msg ("%s, %zu empty arenas, magazine %zu: %lld ops/tick",
+       name, empty_arenas, magazine_size, ops / RUN_TICKS);
+  return creates;
+}
+
+/* Runs "ping-pong" with malloc tuned as by run(), and fails if it
+   obtained more than one arena from the page allocator. */
+static void
+run_ping_pong_no_churn (size_t empty_arenas, size_t magazine_size)
+{
+  long long creates = run ("ping-pong", ping_pong,
+                           empty_arenas, magazine_size);
+  if (creates > 1)
+    fail ("ping-pong created %lld arenas with %zu empty arenas kept",
+          creates, empty_arenas);
+}
+
+void
+test_malloc_bench (void)
+{
+  run ("ping-pong", ping_pong, 0, 0);
+  run_ping_pong_no_churn (1, 0);
+  run_ping_pong_no_churn (1, 8);
+  run ("batch", batch, 0, 0);
+  run ("batch", batch, 1, 0);
+  run ("batch", batch, 1, 8);
+}
@@ -0,0 +1,23 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+
+# Timings vary from run to run.
+s/: \d+ ops\/tick$/: # ops\/tick/ foreach @output;
+
+compare_output ("run", \@output, [<<'EOF']);
+(malloc-bench) begin
+(malloc-bench) ping-pong, 0 empty arenas, magazine 0: # ops/tick
+(malloc-bench) ping-pong, 1 empty arenas, magazine 0: # ops/tick
+(malloc-bench) ping-pong, 1 empty arenas, magazine 8: # ops/tick
+(malloc-bench) batch, 0 empty arenas, magazine 0: # ops/tick
+(malloc-bench) batch, 1 empty arenas, magazine 0: # ops/tick
+(malloc-bench) batch, 1 empty arenas, magazine 8: # ops/tick
+(malloc-bench) end
+EOF
+pass;
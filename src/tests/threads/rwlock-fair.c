@@ -0,0 +1,64 @@
+/* Tests struct rwlock under RWLOCK_FAIR: readers share the lock,
+   a waiting writer holds back newly arriving readers, the readers
+   that queued behind a writer go before the next writer, and a
+   reader can upgrade to a writer and back. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+static thread_func reader_thread;
+static thread_func writer_thread;
+static struct rwlock rwlock;
+
+void
+test_rwlock_fair (void) 
+{
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  rwlock_init (&rwlock, RWLOCK_FAIR);
+
+  rwlock_acquire_read (&rwlock);
+  msg ("main holds the lock for reading");
+  thread_create ("reader 1", PRI_DEFAULT + 1, reader_thread, NULL);
+
+  thread_create ("writer", PRI_DEFAULT + 1, writer_thread, NULL);
+  thread_create ("reader 2", PRI_DEFAULT + 1, reader_thread, NULL);
+  if (!rwlock_try_acquire_read (&rwlock))
+    msg ("main cannot read again while the writer waits");
+  msg ("main releasing the lock");
+  rwlock_release_read (&rwlock);
+
+  rwlock_acquire_read (&rwlock);
+  if (rwlock_upgrade (&rwlock) && rwlock_held_for_write (&rwlock))
+    msg ("main upgraded to writing");
+  rwlock_downgrade (&rwlock);
+  if (!rwlock_try_acquire_write (&rwlock))
+    msg ("main cannot write after downgrading");
+  rwlock_release_read (&rwlock);
+  if (rwlock_try_acquire_write (&rwlock))
+    msg ("main can write after releasing");
+  rwlock_release_write (&rwlock);
+}
+
+static void
+reader_thread (void *aux UNUSED) 
+{
+  msg ("%s waiting to read", thread_name ());
+  rwlock_acquire_read (&rwlock);
+  msg ("%s reading", thread_name ());
+  rwlock_release_read (&rwlock);
+}
+
+static void
+writer_thread (void *aux UNUSED) 
+{
+  msg ("writer waiting to write");
+  rwlock_acquire_write (&rwlock);
+  msg ("writer writing");
+  rwlock_release_write (&rwlock);
+  msg ("writer done");
+}
@@ -0,0 +1,22 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(rwlock-fair) begin
+(rwlock-fair) main holds the lock for reading
+(rwlock-fair) reader 1 waiting to read
+(rwlock-fair) reader 1 reading
+(rwlock-fair) writer waiting to write
+(rwlock-fair) reader 2 waiting to read
+(rwlock-fair) main cannot read again while the writer waits
+(rwlock-fair) main releasing the lock
+(rwlock-fair) writer writing
+(rwlock-fair) writer done
+(rwlock-fair) reader 2 reading
+(rwlock-fair) main upgraded to writing
+(rwlock-fair) main cannot write after downgrading
+(rwlock-fair) main can write after releasing
+(rwlock-fair) end
+EOF
+pass;
@@ -0,0 +1,115 @@
+/* Tests object caches: objects come back constructed, distinct,
+   and aligned, spread over several slabs; objects freed in their
+   constructed state are handed out again in that state; and
+   slabs are colored, so that the first objects of successive
+   slabs do not all sit at the same page offset. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/slab.h"
+#include "threads/vaddr.h"
+
+#define OBJ_CNT 200             /* Objects, several slabs' worth. */
+#define OBJ_MAGIC 0x0b1ec7ed
+
+struct obj
+  {
+    unsigned magic;             /* Set by the constructor. */
+    int serial;                 /* -1 while constructed but unused. */
+    char pad[52];
+  };
+
+static struct kmem_cache obj_cache;
+static struct obj *objs[OBJ_CNT];
+
+static void
+obj_ctor (void *o_)
+{
+  struct obj *o = o_;
+
+  o->magic = OBJ_MAGIC;
+  o->serial = -1;
+}
+
+/* Allocates OBJ_CNT constructed objects into OBJS and tags
+   each with its index. */
+static void
+alloc_all (void)
+{
+  int i;
+
+  for (i = 0; i < OBJ_CNT; i++)
+    {
+      struct obj *o = objs[i] = kmem_cache_alloc (&obj_cache);
+      if (o == NULL)
+        fail ("out of memory allocating object %d", i);
+      if (o->magic != OBJ_MAGIC || o->serial != -1)
+        fail ("object %d not in constructed state", i);
+      if ((uintptr_t) o % 8 != 0)
+        fail ("object %d at %p is misaligned", i, o);
+      o->serial = i;
+    }
+  for (i = 0; i < OBJ_CNT; i++)
+    if (objs[i]->serial != i)
+      fail ("object %d overlaps object %d", i, objs[i]->serial);
+}
+
+/* Frees the objects in OBJS, odd indexes first, restoring each
+   to its constructed state. */
+static void
+free_all (void)
+{
+  int i;
+
+  for (i = 1; i < OBJ_CNT; i += 2)
+    {
+      objs[i]->serial = -1;
+      kmem_cache_free (&obj_cache, objs[i]);
+    }
+  for (i = 0; i < OBJ_CNT; i += 2)
+    {
+      objs[i]->serial = -1;
+      kmem_cache_free (&obj_cache, objs[i]);
+    }
+}
+
+void
+test_slab (void)
+{
+  uintptr_t first_ofs = PGSIZE;
+  bool colored = false;
+  int i;
+
+  kmem_cache_init (&obj_cache, "test", sizeof (struct obj), obj_ctor);
+
+  alloc_all ();
+  msg ("allocated %d constructed objects", OBJ_CNT);
+
+  /* The lowest object in each page is the first of its slab. */
+  for (i = 0; i < OBJ_CNT; i++)
+    {
+      uintptr_t ofs = pg_ofs (objs[i]);
+      bool first = true;
+      int j;
+
+      for (j = 0; j < OBJ_CNT; j++)
+        if (pg_round_down (objs[j]) == pg_round_down (objs[i])
+            && pg_ofs (objs[j]) < ofs)
+          first = false;
+      if (!first)
+        continue;
+      if (first_ofs != PGSIZE && ofs != first_ofs)
+        colored = true;
+      first_ofs = ofs;
+    }
+  if (!colored)
+    fail ("every slab starts at page offset %u", (unsigned) first_ofs);
+  msg ("slabs are colored");
+
+  free_all ();
+  alloc_all ();
+  msg ("reallocated objects are still constructed");
+
+  free_all ();
+  msg ("freed all objects");
+}
@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(slab) begin
+(slab) allocated 200 constructed objects
+(slab) slabs are colored
+(slab) reallocated objects are still constructed
+(slab) freed all objects
+(slab) end
+EOF
+pass;
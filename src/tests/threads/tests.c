@@ -29,6 +29,14 @@ static const struct test tests[] =
     {"priority-preempt", test_priority_preempt},
     {"priority-sema", test_priority_sema},
     {"priority-condvar", test_priority_condvar},
+    {"rwlock-fair", test_rwlock_fair},
+    {"bb-bench", test_bb_bench},
+    {"workqueue", test_workqueue},
+    {"slab", test_slab},
+    {"malloc-bench", test_malloc_bench},
+    {"tlb-bench", test_tlb_bench},
+    {"thread-lookup", test_thread_lookup},
+    {"timer-oneshot", test_timer_oneshot},
     {"mlfqs-load-1", test_mlfqs_load_1},
     {"mlfqs-load-60", test_mlfqs_load_60},
     {"mlfqs-load-avg", test_mlfqs_load_avg},
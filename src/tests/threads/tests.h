@@ -23,6 +23,14 @@ extern test_func test_priority_fifo;
 extern test_func test_priority_preempt;
 extern test_func test_priority_sema;
 extern test_func test_priority_condvar;
+extern test_func test_rwlock_fair;
+extern test_func test_bb_bench;
+extern test_func test_workqueue;
+extern test_func test_slab;
+extern test_func test_malloc_bench;
+extern test_func test_tlb_bench;
+extern test_func test_thread_lookup;
+extern test_func test_timer_oneshot;
 extern test_func test_mlfqs_load_1;
 extern test_func test_mlfqs_load_60;
 extern test_func test_mlfqs_load_avg;
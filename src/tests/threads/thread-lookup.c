@@ -0,0 +1,86 @@
+/* Tests the index of threads by tid: thread_lookup() finds the
+   running thread and every live thread it created, and stops
+   finding each one once it has exited. */
+
+#include <stdio.h>
+#include <string.h>
+#include "tests/threads/tests.h"
+#include "threads/interrupt.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+#define THREAD_CNT 80           /* More than the index has buckets. */
+
+static struct semaphore go[THREAD_CNT];
+static tid_t tids[THREAD_CNT];
+
+/* Waits until told to exit. */
+static void
+child (void *i_)
+{
+  int i = (int) i_;
+
+  sema_down (&go[i]);
+}
+
+/* Returns true if thread_lookup (TID) finds a thread with that
+   tid and with name NAME, false if it finds none, and fails if
+   it finds some other thread. */
+static bool
+lookup (tid_t tid, const char *name)
+{
+  enum intr_level old_level = intr_disable ();
+  struct thread *t = thread_lookup (tid);
+  bool found = t != NULL;
+
+  if (found && (t->tid != tid || strcmp (t->name, name)))
+    {
+      intr_set_level (old_level);
+      fail ("looking up tid %d found thread %d \"%s\"", tid, t->tid,
+            t->name);
+    }
+  intr_set_level (old_level);
+  return found;
+}
+
+void
+test_thread_lookup (void)
+{
+  char name[16];
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  if (!lookup (thread_tid (), thread_name ()))
+    fail ("running thread not found");
+  msg ("found the running thread");
+
+  /* Each child runs at once, at its higher priority, and blocks
+     until told to exit. */
+  for (i = 0; i < THREAD_CNT; i++)
+    {
+      sema_init (&go[i], 0);
+      snprintf (name, sizeof name, "child %d", i);
+      tids[i] = thread_create (name, PRI_DEFAULT + 1, child, (void *) i);
+      if (tids[i] == TID_ERROR)
+        fail ("creating thread %d failed", i);
+    }
+  for (i = 0; i < THREAD_CNT; i++)
+    {
+      snprintf (name, sizeof name, "child %d", i);
+      if (!lookup (tids[i], name))
+        fail ("live thread %d not found", i);
+    }
+  msg ("found %d live threads", THREAD_CNT);
+
+  /* Each child preempts us as soon as it is released, and exits
+     before we run again. */
+  for (i = 0; i < THREAD_CNT; i++)
+    {
+      sema_up (&go[i]);
+      if (lookup (tids[i], ""))
+        fail ("thread %d still found after exiting", i);
+    }
+  msg ("exited threads are not found");
+}
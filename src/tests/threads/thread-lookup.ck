@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(thread-lookup) begin
+(thread-lookup) found the running thread
+(thread-lookup) found 80 live threads
+(thread-lookup) exited threads are not found
+(thread-lookup) end
+EOF
+pass;
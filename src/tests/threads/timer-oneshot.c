@@ -0,0 +1,108 @@
+/* Sleeps for less than a tick many times in a row, so that every
+   wakeup comes from a one-shot timer interrupt, and checks that
+   neither timer_nanotime() nor timer_ticks() falls behind 8254
+   counter 2, which runs freely as a reference clock.  Time lost
+   handling each one-shot would add up to more than a tick. */
+
+#include <debug.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/interrupt.h"
+#include "threads/io.h"
+#include "devices/timer.h"
+
+#define ONESHOT_CNT 1000        /* Number of sub-tick sleeps. */
+#define SLEEP_US 500            /* Length of each sleep. */
+
+/* 8254 input frequency, in Hz. */
+#define PIT_HZ 1193180
+
+/* Nanoseconds per timer tick. */
+#define TICK_NS (1000000000 / TIMER_FREQ)
+
+/* Starts counter 2 counting down from 0x10000 over and over,
+   with its output to the speaker off. */
+static void
+ref_start (void)
+{
+  outb (0x61, (inb (0x61) & ~0x02) | 0x01);     /* Gate on, speaker off. */
+  outb (0x43, 0xb4);    /* CW: counter 2, LSB then MSB, mode 2, binary. */
+  outb (0x42, 0);
+  outb (0x42, 0);
+}
+
+/* Returns the current value of counter 2. */
+static unsigned
+ref_read (void)
+{
+  uint8_t lsb, msb;
+
+  outb (0x43, 0x80);    /* Counter latch command for counter 2. */
+  lsb = inb (0x42);
+  msb = inb (0x42);
+  return lsb | (msb << 8);
+}
+
+/* Returns the absolute difference of A and B. */
+static int64_t
+diff (int64_t a, int64_t b)
+{
+  return a > b ? a - b : b - a;
+}
+
+void
+test_timer_oneshot (void)
+{
+  enum intr_level old_level;
+  int64_t start_ns, start_ticks, ns, ticks, ref, ref_ns;
+  unsigned last, now;
+  int i;
+
+  ASSERT (SLEEP_US * TIMER_FREQ < 1000000);
+
+  ref_start ();
+  timer_sleep (1);
+
+  /* Counter 2 wraps every 55 ms, so it is read after every
+     sleep.  It is read together with the clocks under test at
+     the start and the end. */
+  old_level = intr_disable ();
+  last = ref_read ();
+  start_ns = timer_nanotime ();
+  start_ticks = timer_ticks ();
+  intr_set_level (old_level);
+
+  ref = 0;
+  for (i = 0; i < ONESHOT_CNT; i++)
+    {
+      timer_usleep (SLEEP_US);
+      now = ref_read ();
+      ref += (last - now) & 0xffff;
+      last = now;
+    }
+
+  old_level = intr_disable ();
+  now = ref_read ();
+  ns = timer_nanotime () - start_ns;
+  ticks = timer_ticks () - start_ticks;
+  intr_set_level (old_level);
+  ref += (last - now) & 0xffff;
+  ref_ns = ref * 1000000000 / PIT_HZ;
+  msg ("slept %d times for %d us", ONESHOT_CNT, SLEEP_US);
+
+  if (ns < (int64_t) ONESHOT_CNT * SLEEP_US * 1000)
+    fail ("timer_nanotime advanced %"PRId64" ns, "
+          "less than the %d sleeps", ns, ONESHOT_CNT);
+  if (diff (ns, ref_ns) > TICK_NS / 10)
+    fail ("timer_nanotime advanced %"PRId64" ns, "
+          "but the reference clock %"PRId64" ns", ns, ref_ns);
+  msg ("timer_nanotime agrees with the reference clock");
+
+  /* The tick count has the resolution of a tick, and lags
+     timer_nanotime by up to a tick at the start and the end. */
+  if (diff (ticks * TICK_NS, ref_ns) > TICK_NS + TICK_NS / 10)
+    fail ("%"PRId64" ticks elapsed, "
+          "but the reference clock %"PRId64" ns", ticks, ref_ns);
+  msg ("timer_ticks agrees with the reference clock");
+}
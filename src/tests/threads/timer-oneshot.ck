@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(timer-oneshot) begin
+(timer-oneshot) slept 1000 times for 500 us
+(timer-oneshot) timer_nanotime agrees with the reference clock
+(timer-oneshot) timer_ticks agrees with the reference clock
+(timer-oneshot) end
+EOF
+pass;
@@ -0,0 +1,98 @@
+/* Measures copy throughput between kernel pages scattered over
+   the kernel pool, which depends on how many TLB entries the
+   kernel's direct map needs.  Run it once as is and once with
+   the kernel option -nopse to compare 4 MB against 4 kB
+   mappings; with the default 4 MB of RAM, all of the kernel
+   pool is in the first 4 MB region, which holds kernel text and
+   so is mapped with 4 kB pages either way, so give pintos
+   --mem=32 or more.
+
+   "page copy" copies whole pages from one page to another.
+   "line copy" copies CHUNK bytes from each page in turn to
+   another page, so that nearly every access lands on a page that
+   was not touched recently, which makes TLB misses dominate.
+
+   The timings and page counts vary from run to run, so
+   tlb-bench.ck masks them and only the copies themselves are
+   checked. */
+
+#include <stdio.h>
+#include <string.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/palloc.h"
+#include "threads/pte.h"
+#include "threads/vaddr.h"
+#include "devices/timer.h"
+
+#define PAGE_CNT 256            /* Pages to copy among, at most. */
+#define MIN_PAGES 16            /* Pages needed to run at all. */
+#define COPY_BYTES (16 << 20)   /* Bytes copied per run. */
+#define CHUNK 64                /* Bytes per copy in "line copy". */
+#define STRIDE 37               /* Step between source and dest. */
+
+static uint8_t *pages[PAGE_CNT];
+static size_t page_cnt;
+
+/* Copies COPY_BYTES bytes in copies of SIZE bytes, each from
+   the next page in turn to a page STRIDE pages further on, and
+   prints the throughput as NAME. */
+static void
+run (const char *name, size_t size)
+{
+  size_t copies = COPY_BYTES / size;
+  size_t ofs = 0;
+  size_t i;
+  int64_t start, elapsed;
+
+  start = timer_nanotime ();
+  for (i = 0; i < copies; i++)
+    {
+      size_t src = i % page_cnt;
+      size_t dst = (src + STRIDE) % page_cnt;
+
+      memcpy (pages[dst] + ofs, pages[src] + ofs, size);
+      if (src == page_cnt - 1)
+        ofs = (ofs + size) % PGSIZE;
+    }
+  elapsed = timer_nanotime () - start;
+
+  msg ("%s: %d kB in %lld us (%lld kB/ms)", name, COPY_BYTES / 1024,
+       elapsed / 1000,
+       elapsed > 0 ? (COPY_BYTES / 1024) * 1000000LL / elapsed : 0);
+}
+
+void
+test_tlb_bench (void)
+{
+  size_t large_cnt = 0;
+  size_t i, j;
+
+  /* Every page gets the same contents, so copying between pages
+     at the same offset must leave them unchanged. */
+  for (page_cnt = 0; page_cnt < PAGE_CNT; page_cnt++)
+    {
+      pages[page_cnt] = palloc_get_page (0);
+      if (pages[page_cnt] == NULL)
+        break;
+      for (j = 0; j < PGSIZE; j++)
+        pages[page_cnt][j] = j;
+      if (base_page_dir[pd_no (pages[page_cnt])] & PTE_PS)
+        large_cnt++;
+    }
+  if (page_cnt < MIN_PAGES)
+    fail ("only %zu pages available", page_cnt);
+  msg ("%zu of %zu pages mapped with 4 MB pages", large_cnt, page_cnt);
+
+  run ("page copy", PGSIZE);
+  run ("line copy", CHUNK);
+
+  for (i = 0; i < page_cnt; i++)
+    for (j = 0; j < PGSIZE; j++)
+      if (pages[i][j] != (uint8_t) j)
+        fail ("page %zu byte %zu is %d, expected %d",
+              i, j, pages[i][j], (uint8_t) j);
+
+  for (i = 0; i < page_cnt; i++)
+    palloc_free_page (pages[i]);
+}
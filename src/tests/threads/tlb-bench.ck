@@ -0,0 +1,21 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+
+# Page counts depend on the machine, timings on the run.
+s/\) \d+ of \d+ pages mapped/) # of # pages mapped/ foreach @output;
+s/ in \d+ us \(\d+ kB\/ms\)$/ in # us (# kB\/ms)/ foreach @output;
+
+compare_output ("run", \@output, [<<'EOF']);
+(tlb-bench) begin
+(tlb-bench) # of # pages mapped with 4 MB pages
+(tlb-bench) page copy: 16384 kB in # us (# kB/ms)
+(tlb-bench) line copy: 16384 kB in # us (# kB/ms)
+(tlb-bench) end
+EOF
+pass;
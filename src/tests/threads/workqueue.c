@@ -0,0 +1,101 @@
+/* Tests the kernel worker pool: work submitted from an ordinary
+   thread runs and can be waited for, work may submit and wait
+   for more work without deadlocking the pool, and a released
+   handle's work still runs. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/interrupt.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/workqueue.h"
+
+#define WORK_CNT 32             /* Top-level work items. */
+#define CHILD_CNT 8             /* Children of each parent item. */
+
+static int squares[WORK_CNT];
+static int child_sums[WORK_CNT];
+static struct semaphore released_done;
+
+static void
+square (void *i_)
+{
+  int i = (int) i_;
+
+  squares[i] = i * i;
+}
+
+static void
+add_child (void *i_)
+{
+  int i = (int) i_;
+  enum intr_level old_level = intr_disable ();
+
+  child_sums[i / CHILD_CNT] += i % CHILD_CNT;
+  intr_set_level (old_level);
+}
+
+/* Submits CHILD_CNT children, then waits for all of them. */
+static void
+parent (void *i_)
+{
+  int i = (int) i_;
+  struct work *children[CHILD_CNT];
+  int j;
+
+  for (j = 0; j < CHILD_CNT; j++)
+    {
+      children[j] = workqueue_submit (add_child, (void *) (i * CHILD_CNT + j));
+      ASSERT (children[j] != NULL);
+    }
+  for (j = 0; j < CHILD_CNT; j++)
+    workqueue_wait (children[j]);
+}
+
+static void
+signal_done (void *aux UNUSED)
+{
+  sema_up (&released_done);
+}
+
+static void
+submit_and_wait (work_func *func)
+{
+  struct work *work[WORK_CNT];
+  int i;
+
+  for (i = 0; i < WORK_CNT; i++)
+    {
+      work[i] = workqueue_submit (func, (void *) i);
+      if (work[i] == NULL)
+        fail ("out of memory submitting work %d", i);
+    }
+  for (i = 0; i < WORK_CNT; i++)
+    workqueue_wait (work[i]);
+}
+
+void
+test_workqueue (void)
+{
+  struct work *w;
+  int i;
+
+  submit_and_wait (square);
+  for (i = 0; i < WORK_CNT; i++)
+    if (squares[i] != i * i)
+      fail ("work %d computed %d", i, squares[i]);
+  msg ("independent work completed");
+
+  submit_and_wait (parent);
+  for (i = 0; i < WORK_CNT; i++)
+    if (child_sums[i] != CHILD_CNT * (CHILD_CNT - 1) / 2)
+      fail ("parent %d summed %d", i, child_sums[i]);
+  msg ("nested work completed");
+
+  sema_init (&released_done, 0);
+  w = workqueue_submit (signal_done, NULL);
+  ASSERT (w != NULL);
+  workqueue_release (w);
+  sema_down (&released_done);
+  msg ("released work completed");
+}
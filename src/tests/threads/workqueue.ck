@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(workqueue) begin
+(workqueue) independent work completed
+(workqueue) nested work completed
+(workqueue) released work completed
+(workqueue) end
+EOF
+pass;
@@ -0,0 +1,17 @@
+/* Tests the futex_wait and futex_wake system calls as far as a
+   single-threaded process can: waiting on a word that no longer
+   holds the expected value must return at once, and waking a
+   word nobody waits on must wake nobody. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  int word = 0;
+
+  CHECK (futex_wait (&word, 1) == -1, "futex_wait on changed word");
+  CHECK (futex_wake (&word, 1) == 0, "futex_wake with no waiters");
+}
@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(futex) begin
+(futex) futex_wait on changed word
+(futex) futex_wake with no waiters
+(futex) end
+futex: exit(0)
+EOF
+pass;
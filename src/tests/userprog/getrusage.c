@@ -0,0 +1,21 @@
+/* Tests the getrusage system call: a process that keeps running
+   must see its run ticks go up. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  struct rusage before, after;
+
+  getrusage (&before);
+  CHECK (before.run_ticks >= 0 && before.ready_ticks >= 0,
+         "statistics are not negative");
+  do
+    getrusage (&after);
+  while (after.run_ticks == before.run_ticks);
+  CHECK (after.run_ticks > before.run_ticks, "run ticks increase");
+  CHECK (after.blocks >= before.blocks, "blocks do not decrease");
+}
@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(getrusage) begin
+(getrusage) statistics are not negative
+(getrusage) run ticks increase
+(getrusage) blocks do not decrease
+(getrusage) end
+getrusage: exit(0)
+EOF
+pass;
@@ -10,26 +10,222 @@
 // Modified by Vlad Jahundovics (translation from C++ to C)
 
 #include "threads/boundedbuffer.h"
+#include <debug.h>
+#include "threads/interrupt.h"
 #include "threads/malloc.h"
 
+static void init(struct bounded_buffer *bb, int size, bool spsc);
+static unsigned wait_for_items(struct bounded_buffer *bb);
+static unsigned wait_for_room(struct bounded_buffer *bb);
+
+//----------------------------------------------------------------------
+// bb_init
+//	Initialize BB as an empty buffer that holds up to SIZE items,
+//	for any number of readers and writers.
+//----------------------------------------------------------------------
+
 void bb_init(struct bounded_buffer *bb, int _size)
 {
-  bb->size = _size;
-  // write your code here
+  init(bb, _size, false);
+}
+
+//----------------------------------------------------------------------
+// bb_init_spsc
+//	Like bb_init, but for a buffer that only one thread reads and
+//	only one thread writes.  Reads and writes then take no lock.
+//----------------------------------------------------------------------
+
+void bb_init_spsc(struct bounded_buffer *bb, int _size)
+{
+  init(bb, _size, true);
 }
 
+static void init(struct bounded_buffer *bb, int size, bool spsc)
+{
+  unsigned len = 1;
+
+  ASSERT(size > 0);
+  while (len < (unsigned) size)
+    len <<= 1;
+
+  bb->size = size;
+  bb->mask = len - 1;
+  bb->data = malloc(len * sizeof *bb->data);
+  if (bb->data == NULL)
+    PANIC("bounded buffer allocation failed");
+  bb->spsc = spsc;
+  lock_init(&bb->read_lock);
+  lock_init(&bb->write_lock);
+
+  bb->head = 0;
+  bb->reader_waiting = false;
+  sema_init(&bb->not_empty, 0);
+
+  bb->tail = 0;
+  bb->writer_waiting = false;
+  sema_init(&bb->not_full, 0);
+}
+
+//----------------------------------------------------------------------
+// bb_destroy
+//	Free the storage of BB, which nobody may be using.
+//----------------------------------------------------------------------
+
 void bb_destroy(struct bounded_buffer *bb)
 {
-  // write your code here
+  free(bb->data);
+  bb->data = NULL;
+}
+
+//----------------------------------------------------------------------
+// wait_for_items
+//	Return the number of items in BB, first sleeping until there is
+//	at least one.  Only the (single) reader may call this.
+//
+//	Checking for an empty buffer and going to sleep happen with
+//	interrupts off, so a writer either sees reader_waiting set or
+//	has already published the item the reader is looking for.
+//----------------------------------------------------------------------
+
+static unsigned wait_for_items(struct bounded_buffer *bb)
+{
+  unsigned cnt;
+
+  barrier();
+  cnt = bb->tail - bb->head;
+  while (cnt == 0) {
+    enum intr_level old_level = intr_disable();
+    if (bb->tail == bb->head) {
+      bb->reader_waiting = true;
+      sema_down(&bb->not_empty);
+    }
+    intr_set_level(old_level);
+    barrier();
+    cnt = bb->tail - bb->head;
+  }
+  return cnt;
 }
 
+//----------------------------------------------------------------------
+// wait_for_room
+//	Return the number of free slots in BB, first sleeping until
+//	there is at least one.  Only the (single) writer may call this.
+//----------------------------------------------------------------------
+
+static unsigned wait_for_room(struct bounded_buffer *bb)
+{
+  unsigned room;
+
+  barrier();
+  room = bb->size - (bb->tail - bb->head);
+  while (room == 0) {
+    enum intr_level old_level = intr_disable();
+    if (bb->tail - bb->head == (unsigned) bb->size) {
+      bb->writer_waiting = true;
+      sema_down(&bb->not_full);
+    }
+    intr_set_level(old_level);
+    barrier();
+    room = bb->size - (bb->tail - bb->head);
+  }
+  return room;
+}
+
+//----------------------------------------------------------------------
+// bb_read_n
+//	Remove CNT items from BB into VALUES, oldest first, sleeping
+//	whenever BB is empty.  Items are moved in batches as large as
+//	what is available, and the writer is woken at most once per
+//	batch.
+//----------------------------------------------------------------------
+
+void bb_read_n(struct bounded_buffer *bb, int *values, size_t cnt)
+{
+  if (!bb->spsc)
+    lock_acquire(&bb->read_lock);
+  while (cnt > 0) {
+    unsigned avail = wait_for_items(bb);
+    unsigned n = avail < cnt ? avail : cnt;
+    unsigned i;
+
+    for (i = 0; i < n; i++)
+      values[i] = bb->data[(bb->head + i) & bb->mask];
+    barrier();                  // Copy out before freeing the slots.
+    bb->head += n;
+    barrier();
+
+    if (bb->writer_waiting) {
+      enum intr_level old_level = intr_disable();
+      if (bb->writer_waiting) {
+        bb->writer_waiting = false;
+        sema_up(&bb->not_full);
+      }
+      intr_set_level(old_level);
+    }
+    values += n;
+    cnt -= n;
+  }
+  if (!bb->spsc)
+    lock_release(&bb->read_lock);
+}
+
+//----------------------------------------------------------------------
+// bb_write_n
+//	Append the CNT items in VALUES to BB, sleeping whenever BB is
+//	full.  Items are moved in batches as large as the free space,
+//	and the reader is woken at most once per batch.
+//----------------------------------------------------------------------
+
+void bb_write_n(struct bounded_buffer *bb, const int *values, size_t cnt)
+{
+  if (!bb->spsc)
+    lock_acquire(&bb->write_lock);
+  while (cnt > 0) {
+    unsigned room = wait_for_room(bb);
+    unsigned n = room < cnt ? room : cnt;
+    unsigned i;
+
+    for (i = 0; i < n; i++)
+      bb->data[(bb->tail + i) & bb->mask] = values[i];
+    barrier();                  // Fill the slots before publishing them.
+    bb->tail += n;
+    barrier();
+
+    if (bb->reader_waiting) {
+      enum intr_level old_level = intr_disable();
+      if (bb->reader_waiting) {
+        bb->reader_waiting = false;
+        sema_up(&bb->not_empty);
+      }
+      intr_set_level(old_level);
+    }
+    values += n;
+    cnt -= n;
+  }
+  if (!bb->spsc)
+    lock_release(&bb->write_lock);
+}
+
+//----------------------------------------------------------------------
+// bb_read
+//	Remove and return the oldest item in BB, sleeping until there
+//	is one.
+//----------------------------------------------------------------------
+
 int bb_read(struct bounded_buffer *bb)
 {
-  // write your code here
+  int value;
+
+  bb_read_n(bb, &value, 1);
+  return value;
 }
 
+//----------------------------------------------------------------------
+// bb_write
+//	Append VALUE to BB, sleeping until there is room.
+//----------------------------------------------------------------------
+
 void bb_write(struct bounded_buffer *bb, int value)
 {
-  // write your code here
+  bb_write_n(bb, &value, 1);
 }
-
@@ -8,17 +8,52 @@
 #ifndef BOUNDEDBUFFER_H
 #define BOUNDEDBUFFER_H
 
+#include <stdbool.h>
+#include <stddef.h>
 #include "threads/synch.h"
 
+// Assumed size of a cache line.  The producer's and the consumer's
+// indexes are kept in separate lines so that they never share one.
+#define BB_CACHE_LINE 64
+
+// A bounded buffer of ints, stored in a ring whose length is a
+// power of two, so that positions wrap with a mask.  The consumer
+// owns "head" and the producer owns "tail"; both only ever grow,
+// and tail - head is the number of items in the buffer.  Each side
+// reads the other's index without a lock, and a thread sleeps on a
+// semaphore only when the buffer is empty (reader) or full
+// (writer).
+//
+// With several readers or writers, each side is serialized by its
+// own lock, which turns the buffer back into a single-producer,
+// single-consumer one.  A buffer set up with bb_init_spsc() skips
+// these locks: its user promises that at most one thread reads
+// and one thread writes.
 struct bounded_buffer {
-  int size;
-  // You may add other data fields required for the bounded buffer
+  int size;                     // Maximum number of items.
+  unsigned mask;                // Ring length - 1.
+  int *data;                    // Ring storage.
+  bool spsc;                    // Single producer and consumer?
+  struct lock read_lock;        // Serializes readers unless spsc.
+  struct lock write_lock;       // Serializes writers unless spsc.
+
+  // Consumer side.
+  unsigned head __attribute__ ((aligned (BB_CACHE_LINE)));
+  bool reader_waiting;          // Reader asleep on not_empty?
+  struct semaphore not_empty;   // Upped when an item arrives.
 
+  // Producer side.
+  unsigned tail __attribute__ ((aligned (BB_CACHE_LINE)));
+  bool writer_waiting;          // Writer asleep on not_full?
+  struct semaphore not_full;    // Upped when a slot frees up.
 };
 
 void bb_init(struct bounded_buffer *, int);
+void bb_init_spsc(struct bounded_buffer *, int);
 int bb_read(struct bounded_buffer *);
 void bb_write(struct bounded_buffer *, int);
+void bb_read_n(struct bounded_buffer *, int *values, size_t cnt);
+void bb_write_n(struct bounded_buffer *, const int *values, size_t cnt);
 void bb_destroy(struct bounded_buffer *);
 
 #endif
@@ -0,0 +1,191 @@
+#include "threads/defer.h"
+#include <debug.h>
+#include <stdio.h>
+#include "threads/interrupt.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+/* List of all deferred-work queues. */
+static struct list queues;
+
+/* True once defer_start() has run, so that queues created from
+   then on get a worker at once. */
+static bool started;
+
+static thread_func worker;
+static void start_worker (struct defer_queue *);
+static bool timing_waits (void);
+
+/* Initializes the deferred-work system.  Queues may be created
+   from then on, but their items run only after defer_start(). */
+void
+defer_init (void)
+{
+  list_init (&queues);
+}
+
+/* Starts the worker threads of the queues created so far.  Must
+   be called after thread_start(). */
+void
+defer_start (void)
+{
+  struct list_elem *e;
+
+  ASSERT (!started);
+
+  started = true;
+  for (e = list_begin (&queues); e != list_end (&queues); e = list_next (e))
+    start_worker (list_entry (e, struct defer_queue, queue_elem));
+}
+
+/* Initializes Q as an empty deferred-work queue called NAME.
+   Its worker thread starts now if defer_start() has already
+   run, otherwise when it does. */
+void
+defer_queue_init (struct defer_queue *q, const char *name)
+{
+  ASSERT (q != NULL);
+  ASSERT (name != NULL);
+
+  q->name = name;
+  list_init (&q->items);
+  q->worker = NULL;
+  q->worker_idle = false;
+  q->depth = 0;
+  q->runs = q->coalesced = q->timed = 0;
+  q->wait_ns = q->wait_max_ns = 0;
+  q->max_depth = 0;
+
+  list_push_back (&queues, &q->queue_elem);
+  if (started)
+    start_worker (q);
+}
+
+/* Initializes W to run FUNC with AUX when scheduled. */
+void
+defer_work_init (struct defer_work *w, defer_func *func, void *aux)
+{
+  ASSERT (w != NULL);
+  ASSERT (func != NULL);
+
+  w->func = func;
+  w->aux = aux;
+  w->pending = false;
+  w->queued_at = -1;
+}
+
+/* Schedules W to run in Q's worker thread.  If W is already
+   pending, it runs only once.
+
+   This function may be called from an interrupt handler, in
+   which case the worker runs as soon as the handler returns. */
+void
+defer_schedule (struct defer_queue *q, struct defer_work *w)
+{
+  enum intr_level old_level;
+
+  ASSERT (q != NULL);
+  ASSERT (w != NULL && w->func != NULL);
+
+  old_level = intr_disable ();
+  if (w->pending)
+    q->coalesced++;
+  else
+    {
+      w->pending = true;
+      w->queued_at = timing_waits () ? timer_nanotime () : -1;
+      list_push_back (&q->items, &w->elem);
+      if (++q->depth > q->max_depth)
+        q->max_depth = q->depth;
+
+      if (q->worker_idle)
+        {
+          q->worker_idle = false;
+          thread_unblock (q->worker);
+          thread_preempt ();
+        }
+    }
+  intr_set_level (old_level);
+}
+
+/* Prints the statistics of each deferred-work queue. */
+void
+defer_print_stats (void)
+{
+  struct list_elem *e;
+
+  for (e = list_begin (&queues); e != list_end (&queues); e = list_next (e))
+    {
+      struct defer_queue *q = list_entry (e, struct defer_queue, queue_elem);
+      printf ("Defer: %s: %lld items run, %lld coalesced, max depth %d\n",
+              q->name, q->runs, q->coalesced, q->max_depth);
+      if (q->timed > 0)
+        printf ("Defer: %s: wait avg %lld ns, max %lld ns\n",
+                q->name, q->wait_ns / q->timed, q->wait_max_ns);
+    }
+}
+
+/* Creates the worker thread of Q. */
+static void
+start_worker (struct defer_queue *q)
+{
+  tid_t tid = thread_create (q->name, PRI_MAX, worker, q);
+  if (tid == TID_ERROR)
+    PANIC ("%s: cannot create deferred-work thread", q->name);
+}
+
+/* Worker thread for the deferred-work queue Q_.  Runs the
+   queue's items in order, blocking whenever it is empty. */
+static void
+worker (void *q_)
+{
+  struct defer_queue *q = q_;
+
+  /* The MLFQS ignores PRI_MAX, so make the worker as favored as
+     it allows. */
+  if (thread_mlfqs)
+    thread_set_nice (NICE_MIN);
+
+  intr_disable ();
+  q->worker = thread_current ();
+  for (;;)
+    {
+      struct defer_work *w;
+      int64_t wait;
+
+      while (list_empty (&q->items))
+        {
+          q->worker_idle = true;
+          thread_block ();
+        }
+
+      w = list_entry (list_pop_front (&q->items), struct defer_work, elem);
+      w->pending = false;
+      q->depth--;
+
+      q->runs++;
+      if (w->queued_at >= 0)
+        {
+          wait = timer_nanotime () - w->queued_at;
+          q->timed++;
+          q->wait_ns += wait;
+          if (wait > q->wait_max_ns)
+            q->wait_max_ns = wait;
+        }
+
+      intr_enable ();
+      w->func (w->aux);
+      intr_disable ();
+    }
+}
+
+/* Returns true if items' waits should be timed.  Reading the
+   timer costs several port I/O operations, too many to spend on
+   every defer_schedule() from an interrupt handler unless
+   scheduling or lock statistics were asked for. */
+static bool
+timing_waits (void)
+{
+  return thread_schedstat || synch_profile;
+}
@@ -0,0 +1,65 @@
+#ifndef THREADS_DEFER_H
+#define THREADS_DEFER_H
+
+#include <list.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Deferred work ("bottom halves").
+
+   An interrupt handler that has more to do than acknowledge its
+   device queues a work item on a deferred-work queue and returns.
+   Each queue has its own kernel thread, at PRI_MAX, that runs the
+   queued items in order with interrupts on.  The worker is woken
+   by defer_schedule() and, being of the highest priority, runs as
+   soon as the interrupted handler returns.
+
+   Each queue keeps statistics on how long its items waited
+   between being scheduled and starting to run, if the kernel
+   option -schedstat or -lockstat is given. */
+
+/* Function run by a deferred work item.  Runs in the queue's
+   worker thread with interrupts on.  It may sleep, but that
+   holds up the rest of the queue. */
+typedef void defer_func (void *aux);
+
+/* A deferred work item.  Initialize with defer_work_init().  The
+   owner keeps the storage; it must not be freed while the item
+   is pending. */
+struct defer_work
+  {
+    struct list_elem elem;      /* Element in a queue's item list. */
+    defer_func *func;           /* Function to run. */
+    void *aux;                  /* Auxiliary data for FUNC. */
+    bool pending;               /* Scheduled and not yet started? */
+    int64_t queued_at;          /* timer_nanotime() when scheduled,
+                                   or -1 if not timed. */
+  };
+
+/* A deferred-work queue and its worker thread. */
+struct defer_queue
+  {
+    const char *name;           /* Name, also of the worker thread. */
+    struct list_elem queue_elem; /* Element in list of all queues. */
+    struct list items;          /* Pending items, oldest first. */
+    struct thread *worker;      /* Worker thread, once started. */
+    bool worker_idle;           /* Worker blocked waiting for items? */
+    int depth;                  /* Number of pending items. */
+
+    /* Statistics. */
+    int64_t runs;               /* Items run. */
+    int64_t coalesced;          /* Schedules of already pending items. */
+    int64_t timed;              /* Items whose wait was timed. */
+    int64_t wait_ns;            /* Total time items waited. */
+    int64_t wait_max_ns;        /* Longest wait. */
+    int max_depth;              /* Most items pending at once. */
+  };
+
+void defer_init (void);
+void defer_start (void);
+void defer_queue_init (struct defer_queue *, const char *name);
+void defer_work_init (struct defer_work *, defer_func *, void *aux);
+void defer_schedule (struct defer_queue *, struct defer_work *);
+void defer_print_stats (void);
+
+#endif /* threads/defer.h */
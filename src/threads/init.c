@@ -13,13 +13,21 @@
 #include "devices/serial.h"
 #include "devices/timer.h"
 #include "devices/vga.h"
+#include "threads/defer.h"
+#include "threads/flags.h"
 #include "threads/interrupt.h"
 #include "threads/io.h"
 #include "threads/loader.h"
 #include "threads/malloc.h"
 #include "threads/palloc.h"
+#include "threads/profile.h"
 #include "threads/pte.h"
+#include "threads/slab.h"
+#include "threads/synch.h"
+#include "threads/synchlist.h"
 #include "threads/thread.h"
+#include "threads/trace.h"
+#include "threads/workqueue.h"
 #ifdef USERPROG
 #include "userprog/process.h"
 #include "userprog/exception.h"
@@ -49,8 +57,17 @@ static bool format_filesys;
 /* -q: Power off after kernel tasks complete? */
 bool power_off_when_done;
 
+/* -nopse: Map kernel memory with 4 kB pages only? */
+static bool no_large_pages;
+
+/* Page Size Extensions (4 MB pages): the bit in CR4 that enables
+   them and the CPUID feature bit that reports support. */
+#define CR4_PSE 0x00000010
+#define CPUID_PSE 0x00000008
+
 static void ram_init (void);
 static void paging_init (void);
+static bool cpu_has_pse (void);
 
 static char **read_command_line (void);
 static char **parse_options (char **argv);
@@ -86,6 +103,10 @@ main (void)
   /* Initialize memory system. */
   palloc_init ();
   malloc_init ();
+  slab_init ();
+  sl_cache_init ();
+  trace_init ();
+  profile_init ();
   paging_init ();
 
   /* Segmentation. */
@@ -96,16 +117,20 @@ main (void)
 
   /* Initialize interrupt handlers. */
   intr_init ();
+  defer_init ();
   timer_init ();
   kbd_init ();
   input_init ();
 #ifdef USERPROG
   exception_init ();
   syscall_init ();
+  process_init ();
 #endif
 
   /* Start thread scheduler and enable interrupts. */
   thread_start ();
+  defer_start ();
+  workqueue_init ();
   serial_init_queue ();
   timer_calibrate ();
 
@@ -148,6 +173,13 @@ ram_init (void)
    new page directory.  Points base_page_dir to the page
    directory it creates.
 
+   If the CPU supports 4 MB pages, each 4 MB region of RAM that
+   does not contain kernel text is mapped by a single page
+   directory entry, which saves a page table and lets one TLB
+   entry cover the whole region.  The regions holding kernel text
+   are still mapped page by page, so that the text stays
+   read-only, as is any partial region at the end of RAM.
+
    At the time this function is called, the active page table
    (set up by loader.S) only maps the first 4 MB of RAM, so we
    should not try to use extravagant amounts of memory.
@@ -157,11 +189,13 @@ paging_init (void)
 {
   uint32_t *pd, *pt;
   size_t page;
+  size_t large_cnt = 0, pt_cnt = 0;
+  bool large_pages = !no_large_pages && cpu_has_pse ();
   extern char _start, _end_kernel_text;
 
   pd = base_page_dir = palloc_get_page (PAL_ASSERT | PAL_ZERO);
   pt = NULL;
-  for (page = 0; page < ram_pages; page++) 
+  for (page = 0; page < ram_pages; ) 
     {
       uintptr_t paddr = page * PGSIZE;
       char *vaddr = ptov (paddr);
@@ -169,14 +203,38 @@ paging_init (void)
       size_t pte_idx = pt_no (vaddr);
       bool in_kernel_text = &_start <= vaddr && vaddr < &_end_kernel_text;
 
+      if (large_pages && pte_idx == 0
+          && page + PTSPAN / PGSIZE <= ram_pages
+          && (vaddr + PTSPAN <= &_start || vaddr >= &_end_kernel_text))
+        {
+          pd[pde_idx] = pde_create_kernel_large (vaddr, true);
+          large_cnt++;
+          page += PTSPAN / PGSIZE;
+          continue;
+        }
+
       if (pd[pde_idx] == 0)
         {
           pt = palloc_get_page (PAL_ASSERT | PAL_ZERO);
           pd[pde_idx] = pde_create (pt);
+          pt_cnt++;
         }
 
       pt[pte_idx] = pte_create_kernel (vaddr, !in_kernel_text);
+      page++;
+    }
+
+  /* Large page directory entries are only honored with the Page
+     Size Extensions bit set in CR4.  See [IA32-v3a] 2.5 "Control
+     Registers". */
+  if (large_pages)
+    {
+      uint32_t cr4;
+      asm volatile ("movl %%cr4, %0" : "=r" (cr4));
+      asm volatile ("movl %0, %%cr4" : : "r" (cr4 | CR4_PSE));
     }
+  printf ("Kernel memory mapped with %zu 4 MB pages and %zu page tables.\n",
+          large_cnt, pt_cnt);
 
   /* Store the physical address of the page directory into CR3
      aka PDBR (page directory base register).  This activates our
@@ -186,6 +244,31 @@ paging_init (void)
   asm volatile ("movl %0, %%cr3" : : "r" (vtop (base_page_dir)));
 }
 
+/* Returns true if the CPU supports 4 MB pages, as reported by
+   CPUID.  A CPU that does not have CPUID, which shows in the ID
+   flag in EFLAGS being impossible to change, does not support
+   them.  See [IA32-v2a] "CPUID". */
+static bool
+cpu_has_pse (void)
+{
+  uint32_t old_flags, new_flags;
+  uint32_t max_leaf, features, ebx, ecx;
+
+  asm volatile ("pushfl; popl %0; movl %0, %1; xorl %2, %1; "
+                "pushl %1; popfl; pushfl; popl %1; pushl %0; popfl"
+                : "=&r" (old_flags), "=&r" (new_flags) : "i" (FLAG_ID));
+  if (((old_flags ^ new_flags) & FLAG_ID) == 0)
+    return false;
+
+  asm volatile ("cpuid" : "=a" (max_leaf), "=b" (ebx), "=c" (ecx),
+                "=d" (features) : "a" (0));
+  if (max_leaf < 1)
+    return false;
+  asm volatile ("cpuid" : "=a" (max_leaf), "=b" (ebx), "=c" (ecx),
+                "=d" (features) : "a" (1));
+  return (features & CPUID_PSE) != 0;
+}
+
 /* Breaks the kernel command line into words and returns them as
    an argv-like array. */
 static char **
@@ -244,6 +327,29 @@ parse_options (char **argv)
         random_init (atoi (value));
       else if (!strcmp (name, "-mlfqs"))
         thread_mlfqs = true;
+      else if (!strcmp (name, "-nohz"))
+        timer_nohz = true;
+      else if (!strcmp (name, "-nopse"))
+        no_large_pages = true;
+      else if (!strcmp (name, "-schedstat"))
+        thread_schedstat = true;
+      else if (!strcmp (name, "-lockstat"))
+        synch_profile = true;
+      else if (!strcmp (name, "-lpt"))
+        timer_loops_preset = atoi (value);
+      else if (!strcmp (name, "-profile"))
+        {
+          profile_enabled = true;
+          profile_stacks = value != NULL && !strcmp (value, "stack");
+        }
+      else if (!strcmp (name, "-trace"))
+        trace_enabled = true;
+      else if (!strcmp (name, "-workers"))
+        workqueue_workers = atoi (value);
+      else if (!strcmp (name, "-malloc-empty"))
+        malloc_empty_arenas = atoi (value);
+      else if (!strcmp (name, "-malloc-mag"))
+        malloc_magazine_size = atoi (value);
 #ifdef USERPROG
       else if (!strcmp (name, "-ul"))
         user_page_limit = atoi (value);
@@ -349,6 +455,16 @@ usage (void)
           "  -f                 Format file system disk during startup.\n"
           "  -rs=SEED           Set random number seed to SEED.\n"
           "  -mlfqs             Use multi-level feedback queue scheduler.\n"
+          "  -nohz              Stop the periodic timer tick while idle.\n"
+          "  -nopse             Map kernel memory with 4 kB pages only.\n"
+          "  -schedstat         Time ready waits and wakeup latencies.\n"
+          "  -lockstat          Gather lock contention statistics.\n"
+          "  -lpt=LOOPS         Skip timer calibration, using LOOPS per tick.\n"
+          "  -profile[=stack]   Sample kernel eips (and call stacks) per tick.\n"
+          "  -trace             Record scheduler events, dumped at shutdown.\n"
+          "  -workers=N         Run N kernel worker threads (default 2).\n"
+          "  -malloc-empty=N    Keep N empty malloc arenas per size (default 1).\n"
+          "  -malloc-mag=N      Cache N freed blocks per malloc size (default 8).\n"
 #ifdef USERPROG
           "  -ul=COUNT          Limit user memory to COUNT pages.\n"
 #endif
@@ -370,6 +486,8 @@ power_off (void)
 #endif
 
   print_stats ();
+  trace_dump ();
+  profile_dump ();
 
   printf ("Powering off...\n");
   serial_flush ();
@@ -386,7 +504,12 @@ static void
 print_stats (void) 
 {
   timer_print_stats ();
+  palloc_print_stats ();
+  slab_print_stats ();
   thread_print_stats ();
+  synch_print_stats ();
+  defer_print_stats ();
+  workqueue_print_stats ();
 #ifdef FILESYS
   disk_print_stats ();
 #endif
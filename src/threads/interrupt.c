@@ -7,6 +7,7 @@
 #include "threads/intr-stubs.h"
 #include "threads/io.h"
 #include "threads/thread.h"
+#include "threads/trace.h"
 #include "threads/vaddr.h"
 #include "devices/timer.h"
 
@@ -353,8 +354,14 @@ intr_handler (struct intr_frame *frame)
 
       in_external_intr = true;
       yield_on_return = false;
+
+      /* If the CPU was halted with the periodic tick stopped,
+         bring the tick count up to date first. */
+      timer_idle_exit ();
     }
 
+  TRACE (TRACE_INTR, frame->vec_no, thread_current ()->tid, 0);
+
   /* Invoke the interrupt's handler. */
   handler = intr_handlers[frame->vec_no];
   if (handler != NULL)
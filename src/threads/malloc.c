@@ -5,6 +5,7 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include "threads/interrupt.h"
 #include "threads/palloc.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
@@ -26,7 +27,17 @@
    When we free a block, we add it to its descriptor's free list.
    But if the arena that the block was in now has no in-use
    blocks, we remove all of the arena's blocks from the free list
-   and give the arena back to the page allocator.
+   and give the arena back to the page allocator, unless the
+   descriptor has fewer than malloc_empty_arenas empty arenas
+   already.  Keeping a few empty arenas means that a block
+   allocated and freed over and over at an arena boundary does
+   not cost a page allocation and free each time.
+
+   In front of the free list, each descriptor has a small
+   "magazine" of recently freed blocks, which malloc() and free()
+   take from and add to with interrupts briefly disabled instead
+   of acquiring the descriptor's lock.  Blocks in a magazine
+   still count as in use in their arenas.
 
    We can't handle blocks bigger than 2 kB using this scheme,
    because they're too big to fit in a single page with a
@@ -34,13 +45,22 @@
    with the page allocator and sticking the allocation size at
    the beginning of the allocated block's arena header. */
 
+/* Maximum number of blocks in a magazine. */
+#define MAGAZINE_MAX 16
+
 /* Descriptor. */
 struct desc
   {
     size_t block_size;          /* Size of each element in bytes. */
     size_t blocks_per_arena;    /* Number of blocks in an arena. */
     struct list free_list;      /* List of free blocks. */
+    size_t empty_cnt;           /* Arenas with no blocks in use. */
+    long long arena_creates;    /* Arenas obtained from palloc. */
     struct lock lock;           /* Lock. */
+
+    /* Recently freed blocks, accessed with interrupts off. */
+    void *magazine[MAGAZINE_MAX];
+    size_t magazine_cnt;        /* Number of blocks in MAGAZINE. */
   };
 
 /* Magic number for detecting arena corruption. */
@@ -60,12 +80,22 @@ struct block
     struct list_elem free_elem; /* Free list element. */
   };
 
+/* Empty arenas kept per descriptor.
+   Set by kernel command-line option "-malloc-empty=N". */
+size_t malloc_empty_arenas = 1;
+
+/* Blocks kept in each descriptor's magazine, at most
+   MAGAZINE_MAX, or 0 to bypass the magazines.
+   Set by kernel command-line option "-malloc-mag=N". */
+size_t malloc_magazine_size = 8;
+
 /* Our set of descriptors. */
 static struct desc descs[10];   /* Descriptors. */
 static size_t desc_cnt;         /* Number of descriptors. */
 
 static struct arena *block_to_arena (struct block *);
 static struct block *arena_to_block (struct arena *, size_t idx);
+static void free_block (struct desc *, struct block *);
 
 /* Initializes the malloc() descriptors. */
 void
@@ -80,7 +110,10 @@ malloc_init (void)
       d->block_size = block_size;
       d->blocks_per_arena = (PGSIZE - sizeof (struct arena)) / block_size;
       list_init (&d->free_list);
+      d->empty_cnt = 0;
+      d->arena_creates = 0;
       lock_init (&d->lock);
+      d->magazine_cnt = 0;
     }
 }
 
@@ -92,6 +125,7 @@ malloc (size_t size)
   struct desc *d;
   struct block *b;
   struct arena *a;
+  enum intr_level old_level;
 
   /* A null pointer satisfies a request for 0 bytes. */
   if (size == 0)
@@ -119,6 +153,16 @@ malloc (size_t size)
       return a + 1;
     }
 
+  /* Reuse a recently freed block, if there is one. */
+  old_level = intr_disable ();
+  if (d->magazine_cnt > 0)
+    {
+      b = d->magazine[--d->magazine_cnt];
+      intr_set_level (old_level);
+      return b;
+    }
+  intr_set_level (old_level);
+
   lock_acquire (&d->lock);
 
   /* If the free list is empty, create a new arena. */
@@ -138,6 +182,8 @@ malloc (size_t size)
       a->magic = ARENA_MAGIC;
       a->desc = d;
       a->free_cnt = d->blocks_per_arena;
+      d->empty_cnt++;
+      d->arena_creates++;
       for (i = 0; i < d->blocks_per_arena; i++) 
         {
           struct block *b = arena_to_block (a, i);
@@ -148,7 +194,8 @@ malloc (size_t size)
   /* Get a block from free list and return it. */
   b = list_entry (list_pop_front (&d->free_list), struct block, free_elem);
   a = block_to_arena (b);
-  a->free_cnt--;
+  if (a->free_cnt-- == d->blocks_per_arena)
+    d->empty_cnt--;
   lock_release (&d->lock);
   return b;
 }
@@ -227,32 +274,25 @@ free (void *p)
       if (d != NULL) 
         {
           /* It's a normal block.  We handle it here. */
+          enum intr_level old_level;
 
 #ifndef NDEBUG
           /* Clear the block to help detect use-after-free bugs. */
           memset (b, 0xcc, d->block_size);
 #endif
-  
-          lock_acquire (&d->lock);
-
-          /* Add block to free list. */
-          list_push_front (&d->free_list, &b->free_elem);
 
-          /* If the arena is now entirely unused, free it. */
-          if (++a->free_cnt >= d->blocks_per_arena) 
+          /* Put it in the magazine, if there is room. */
+          old_level = intr_disable ();
+          if (d->magazine_cnt < malloc_magazine_size
+              && d->magazine_cnt < MAGAZINE_MAX)
             {
-              size_t i;
-
-              ASSERT (a->free_cnt == d->blocks_per_arena);
-              for (i = 0; i < d->blocks_per_arena; i++) 
-                {
-                  struct block *b = arena_to_block (a, i);
-                  list_remove (&b->free_elem);
-                }
-              palloc_free_page (a);
+              d->magazine[d->magazine_cnt++] = b;
+              intr_set_level (old_level);
+              return;
             }
+          intr_set_level (old_level);
 
-          lock_release (&d->lock);
+          free_block (d, b);
         }
       else
         {
@@ -263,6 +303,81 @@ free (void *p)
     }
 }
 
+/* Returns the blocks in every descriptor's magazine to their
+   free lists.  Call after lowering malloc_magazine_size, so that
+   blocks cached under the old setting do not linger. */
+void
+malloc_drain (void)
+{
+  struct desc *d;
+
+  for (d = descs; d < descs + desc_cnt; d++)
+    for (;;)
+      {
+        enum intr_level old_level = intr_disable ();
+        struct block *b = NULL;
+
+        if (d->magazine_cnt > 0)
+          b = d->magazine[--d->magazine_cnt];
+        intr_set_level (old_level);
+
+        if (b == NULL)
+          break;
+        free_block (d, b);
+      }
+}
+
+/* Returns the number of arenas obtained from the page allocator
+   since boot, for all block sizes. */
+long long
+malloc_arena_creates (void)
+{
+  enum intr_level old_level = intr_disable ();
+  long long creates = 0;
+  struct desc *d;
+
+  for (d = descs; d < descs + desc_cnt; d++)
+    creates += d->arena_creates;
+  intr_set_level (old_level);
+  return creates;
+}
+
+/* Adds block B, which belongs to descriptor D, to D's free list.
+   If its arena is now entirely unused, keeps the arena if D is
+   short of empty arenas, otherwise frees it. */
+static void
+free_block (struct desc *d, struct block *b)
+{
+  struct arena *a = block_to_arena (b);
+
+  lock_acquire (&d->lock);
+
+  /* Add block to free list. */
+  list_push_front (&d->free_list, &b->free_elem);
+
+  /* If the arena is now entirely unused, keep it if we are short
+     of empty arenas, otherwise free it. */
+  if (++a->free_cnt >= d->blocks_per_arena) 
+    {
+      size_t i;
+
+      ASSERT (a->free_cnt == d->blocks_per_arena);
+      if (d->empty_cnt < malloc_empty_arenas)
+        d->empty_cnt++;
+      else
+        {
+          for (i = 0; i < d->blocks_per_arena; i++) 
+            {
+              struct block *b = arena_to_block (a, i);
+              list_remove (&b->free_elem);
+            }
+          palloc_free_page (a);
+        }
+    }
+
+  lock_release (&d->lock);
+}
+
 /* Returns the arena that block B is inside. */
 static struct arena *
 block_to_arena (struct block *b)
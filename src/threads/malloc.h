@@ -4,10 +4,16 @@
 #include <debug.h>
 #include <stddef.h>
 
+/* Tuning, set by kernel command-line options. */
+extern size_t malloc_empty_arenas;
+extern size_t malloc_magazine_size;
+
 void malloc_init (void);
 void *malloc (size_t) __attribute__ ((malloc));
 void *calloc (size_t, size_t) __attribute__ ((malloc));
 void *realloc (void *, size_t);
 void free (void *);
+void malloc_drain (void);
+long long malloc_arena_creates (void);
 
 #endif /* threads/malloc.h */
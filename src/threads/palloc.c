@@ -1,15 +1,15 @@
 #include "threads/palloc.h"
-#include <bitmap.h>
 #include <debug.h>
 #include <inttypes.h>
+#include <list.h>
 #include <round.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 #include "threads/init.h"
+#include "threads/interrupt.h"
 #include "threads/loader.h"
-#include "threads/synch.h"
 #include "threads/vaddr.h"
 
 /* Page allocator.  Hands out memory in page-size (or
@@ -26,12 +26,65 @@
    half to the user pool.  That should be huge overkill for the
    kernel pool, but that's just fine for demonstration purposes. */
 
+/* Pools are managed by a binary buddy allocator.  A pool's pages
+   are grouped into free blocks of 2**ORDER pages whose index
+   within the pool is a multiple of their size, kept on one free
+   list per order.  An allocation takes a block from the smallest
+   nonempty list that is big enough, splitting it in halves until
+   it fits, and gives back the pages beyond the request as smaller
+   blocks.  Freeing a block merges it with its "buddy", the other
+   half of the block it was split from, for as long as the buddy
+   is free too.  Both take O(log n) time in the size of the pool.
+
+   Each page has a struct page_block in an array at the start of
+   the pool.  Only the entries for the first pages of free blocks
+   are meaningful; the free pages themselves are never written,
+   so a page that was zeroed stays zeroed while it is free.
+
+   The free lists are protected by disabling interrupts rather
+   than by a lock: every operation on them is short, and pages
+   must be freeable from schedule_tail(), where sleeping on a lock
+   is not an option.
+
+   So that PAL_ZERO requests need not clear a page while the
+   caller waits, the idle thread takes free pages out of the
+   buddy lists, zeroes them, and keeps up to PREZERO_MAX of them
+   per pool on a "pre-zeroed" list, linked through their
+   page_block entries.  A single-page PAL_ZERO request takes a
+   page from that list if it can.  Pre-zeroed pages still count
+   as free: when the buddy lists cannot satisfy a request, the
+   pre-zeroed pages go back to them and the request is retried. */
+#define ORDER_CNT 21                    /* Up to 2**20 pages, 4 GB. */
+#define PREZERO_MAX 64                  /* Max. pre-zeroed pages per pool. */
+
+struct page_block
+  {
+    struct list_elem elem;              /* Element in a free list. */
+    uint8_t order;                      /* Block is 2**ORDER pages. */
+    bool free;                          /* First page of a free block? */
+  };
+
 /* A memory pool. */
 struct pool
   {
-    struct lock lock;                   /* Mutual exclusion. */
-    struct bitmap *used_map;            /* Bitmap of free pages. */
+    const char *name;                   /* Name, for statistics. */
+    struct page_block *blocks;          /* One entry per page. */
     uint8_t *base;                      /* Base of pool. */
+    size_t page_cnt;                    /* Number of pages in pool. */
+    size_t free_pages;                  /* Free pages, incl. pre-zeroed. */
+    struct list free_lists[ORDER_CNT];  /* Free blocks, by order. */
+    size_t free_blocks[ORDER_CNT];      /* Length of each free list. */
+    struct list zeroed;                 /* Pre-zeroed free pages. */
+    size_t zeroed_cnt;                  /* Length of ZEROED. */
+
+    /* Statistics. */
+    long long allocs;                   /* Successful allocations. */
+    long long failures;                 /* Failed allocations... */
+    long long frag_failures;            /* ...despite enough free pages. */
+    long long zero_hits;                /* PAL_ZERO served pre-zeroed. */
+    long long zero_misses;              /* PAL_ZERO zeroed on demand. */
+    long long prezeroed;                /* Pages zeroed by idle thread. */
+    long long reclaimed;                /* Pre-zeroed pages given back. */
   };
 
 /* Two pools: one for kernel data, one for user pages. */
@@ -43,6 +96,13 @@ size_t user_page_limit = SIZE_MAX;
 static void init_pool (struct pool *, void *base, size_t page_cnt,
                        const char *name);
 static bool page_from_pool (const struct pool *, void *page);
+static int order_for (size_t page_cnt);
+static size_t take_block (struct pool *, int order);
+static void free_block (struct pool *, size_t idx, int order);
+static void free_range (struct pool *, size_t idx, size_t page_cnt);
+static void reclaim_zeroed (struct pool *);
+static bool zero_page (struct pool *);
+static void print_pool_stats (struct pool *);
 
 /* Initializes the page allocator. */
 void
@@ -78,24 +138,66 @@ void *
 palloc_get_multiple (enum palloc_flags flags, size_t page_cnt)
 {
   struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
+  enum intr_level old_level;
+  bool zeroed = false;
   void *pages;
-  size_t page_idx;
+  int order;
 
   if (page_cnt == 0)
     return NULL;
 
-  lock_acquire (&pool->lock);
-  page_idx = bitmap_scan_and_flip (pool->used_map, 0, page_cnt, false);
-  lock_release (&pool->lock);
-
-  if (page_idx != BITMAP_ERROR)
-    pages = pool->base + PGSIZE * page_idx;
+  order = order_for (page_cnt);
+  old_level = intr_disable ();
+  if ((flags & PAL_ZERO) && page_cnt == 1 && pool->zeroed_cnt > 0)
+    {
+      struct page_block *b = list_entry (list_pop_front (&pool->zeroed),
+                                         struct page_block, elem);
+      pool->zeroed_cnt--;
+      pool->free_pages--;
+      pool->allocs++;
+      pages = pool->base + PGSIZE * (b - pool->blocks);
+      zeroed = true;
+    }
+  else if (order < ORDER_CNT)
+    {
+      size_t page_idx = take_block (pool, order);
+      if (page_idx == SIZE_MAX && pool->zeroed_cnt > 0)
+        {
+          reclaim_zeroed (pool);
+          page_idx = take_block (pool, order);
+        }
+      if (page_idx != SIZE_MAX)
+        {
+          /* Give back the pages past the end of the request. */
+          free_range (pool, page_idx + page_cnt,
+                      ((size_t) 1 << order) - page_cnt);
+          pool->free_pages -= page_cnt;
+          pool->allocs++;
+          pages = pool->base + PGSIZE * page_idx;
+        }
+      else
+        pages = NULL;
+    }
   else
     pages = NULL;
+  if (pages == NULL)
+    {
+      pool->failures++;
+      if (pool->free_pages >= page_cnt)
+        pool->frag_failures++;
+    }
+  if (flags & PAL_ZERO)
+    {
+      if (zeroed)
+        pool->zero_hits++;
+      else
+        pool->zero_misses++;
+    }
+  intr_set_level (old_level);
 
   if (pages != NULL) 
     {
-      if (flags & PAL_ZERO)
+      if ((flags & PAL_ZERO) && !zeroed)
         memset (pages, 0, PGSIZE * page_cnt);
     }
   else 
@@ -125,6 +227,7 @@ void
 palloc_free_multiple (void *pages, size_t page_cnt) 
 {
   struct pool *pool;
+  enum intr_level old_level;
   size_t page_idx;
 
   ASSERT (pg_ofs (pages) == 0);
@@ -139,13 +242,16 @@ palloc_free_multiple (void *pages, size_t page_cnt)
     NOT_REACHED ();
 
   page_idx = pg_no (pages) - pg_no (pool->base);
+  ASSERT (page_idx + page_cnt <= pool->page_cnt);
 
 #ifndef NDEBUG
   memset (pages, 0xcc, PGSIZE * page_cnt);
 #endif
 
-  ASSERT (bitmap_all (pool->used_map, page_idx, page_cnt));
-  bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+  old_level = intr_disable ();
+  free_range (pool, page_idx, page_cnt);
+  pool->free_pages += page_cnt;
+  intr_set_level (old_level);
 }
 
 /* Frees the page at PAGE. */
@@ -155,25 +261,63 @@ palloc_free_page (void *page)
   palloc_free_multiple (page, 1);
 }
 
+/* Zeroes a free page for later PAL_ZERO requests, if either
+   pool has fewer than PREZERO_MAX pre-zeroed pages.  Returns
+   true if it zeroed a page, false if there was nothing to do.
+   Called by the idle thread with interrupts on, so the zeroing
+   itself can be preempted. */
+bool
+palloc_zero_idle (void)
+{
+  return zero_page (&kernel_pool) || zero_page (&user_pool);
+}
+
+/* Prints page allocator statistics. */
+void
+palloc_print_stats (void)
+{
+  print_pool_stats (&kernel_pool);
+  print_pool_stats (&user_pool);
+}
+
 /* Initializes pool P as starting at START and ending at END,
    naming it NAME for debugging purposes. */
 static void
 init_pool (struct pool *p, void *base, size_t page_cnt, const char *name) 
 {
-  /* We'll put the pool's used_map at its base.
-     Calculate the space needed for the bitmap
+  /* We'll put the pool's page_block array at its base.
+     Calculate the space needed for the array
      and subtract it from the pool's size. */
-  size_t bm_pages = DIV_ROUND_UP (bitmap_buf_size (page_cnt), PGSIZE);
-  if (bm_pages > page_cnt)
-    PANIC ("Not enough memory in %s for bitmap.", name);
-  page_cnt -= bm_pages;
+  size_t meta_pages = DIV_ROUND_UP (page_cnt * sizeof *p->blocks, PGSIZE);
+  size_t i;
+  int order;
+
+  if (meta_pages > page_cnt)
+    PANIC ("Not enough memory in %s for page blocks.", name);
+  page_cnt -= meta_pages;
 
   printf ("%zu pages available in %s.\n", page_cnt, name);
 
   /* Initialize the pool. */
-  lock_init (&p->lock);
-  p->used_map = bitmap_create_in_buf (page_cnt, base, bm_pages * PGSIZE);
-  p->base = base + bm_pages * PGSIZE;
+  p->name = name;
+  p->blocks = base;
+  p->base = base + meta_pages * PGSIZE;
+  p->page_cnt = page_cnt;
+  p->free_pages = page_cnt;
+  for (order = 0; order < ORDER_CNT; order++)
+    {
+      list_init (&p->free_lists[order]);
+      p->free_blocks[order] = 0;
+    }
+  list_init (&p->zeroed);
+  p->zeroed_cnt = 0;
+  p->allocs = p->failures = p->frag_failures = 0;
+  p->zero_hits = p->zero_misses = p->prezeroed = p->reclaimed = 0;
+  for (i = 0; i < page_cnt; i++)
+    p->blocks[i].free = false;
+
+  /* Free all of its pages as the largest blocks possible. */
+  free_range (p, 0, page_cnt);
 }
 
 /* Returns true if PAGE was allocated from POOL,
@@ -183,7 +327,213 @@ page_from_pool (const struct pool *pool, void *page)
 {
   size_t page_no = pg_no (page);
   size_t start_page = pg_no (pool->base);
-  size_t end_page = start_page + bitmap_size (pool->used_map);
+  size_t end_page = start_page + pool->page_cnt;
 
   return page_no >= start_page && page_no < end_page;
 }
+
+/* Returns the smallest order whose blocks hold PAGE_CNT pages,
+   or ORDER_CNT if there is none. */
+static int
+order_for (size_t page_cnt)
+{
+  int order = 0;
+
+  while (order < ORDER_CNT && ((size_t) 1 << order) < page_cnt)
+    order++;
+  return order;
+}
+
+/* Removes a free block of 2**ORDER pages from POOL, splitting a
+   larger one if necessary, and returns the index of its first
+   page, or SIZE_MAX if there is none.  Interrupts must be off.
+   The caller must account for the pages in POOL->free_pages. */
+static size_t
+take_block (struct pool *pool, int order)
+{
+  struct page_block *b;
+  size_t idx;
+  int k;
+
+  for (k = order; k < ORDER_CNT; k++)
+    if (!list_empty (&pool->free_lists[k]))
+      break;
+  if (k == ORDER_CNT)
+    return SIZE_MAX;
+
+  b = list_entry (list_pop_front (&pool->free_lists[k]),
+                  struct page_block, elem);
+  b->free = false;
+  pool->free_blocks[k]--;
+  idx = b - pool->blocks;
+
+  /* Split, freeing the upper half each time. */
+  while (k > order)
+    {
+      struct page_block *upper;
+
+      k--;
+      upper = &pool->blocks[idx + ((size_t) 1 << k)];
+      upper->order = k;
+      upper->free = true;
+      list_push_front (&pool->free_lists[k], &upper->elem);
+      pool->free_blocks[k]++;
+    }
+  return idx;
+}
+
+/* Returns the block of 2**ORDER pages at page index IDX to
+   POOL's free lists, merging it with its buddy as many times as
+   possible.  IDX must be a multiple of 2**ORDER.  Interrupts must
+   be off, once the pool is in use. */
+static void
+free_block (struct pool *pool, size_t idx, int order)
+{
+  ASSERT (idx % ((size_t) 1 << order) == 0);
+  ASSERT (!pool->blocks[idx].free);
+
+  while (order < ORDER_CNT - 1)
+    {
+      size_t buddy = idx ^ ((size_t) 1 << order);
+      struct page_block *b = &pool->blocks[buddy];
+
+      if (buddy + ((size_t) 1 << order) > pool->page_cnt
+          || !b->free || b->order != order)
+        break;
+      list_remove (&b->elem);
+      b->free = false;
+      pool->free_blocks[order]--;
+      if (buddy < idx)
+        idx = buddy;
+      order++;
+    }
+
+  pool->blocks[idx].order = order;
+  pool->blocks[idx].free = true;
+  list_push_front (&pool->free_lists[order], &pool->blocks[idx].elem);
+  pool->free_blocks[order]++;
+}
+
+/* Frees the PAGE_CNT pages starting at page index IDX in POOL,
+   as the fewest blocks that are aligned to their size.
+   Interrupts must be off, once the pool is in use.  The caller
+   must account for the pages in POOL->free_pages. */
+static void
+free_range (struct pool *pool, size_t idx, size_t page_cnt)
+{
+  while (page_cnt > 0)
+    {
+      int order = 0;
+
+      while (order + 1 < ORDER_CNT
+             && idx % ((size_t) 2 << order) == 0
+             && ((size_t) 2 << order) <= page_cnt)
+        order++;
+      free_block (pool, idx, order);
+      idx += (size_t) 1 << order;
+      page_cnt -= (size_t) 1 << order;
+    }
+}
+
+/* Returns all of POOL's pre-zeroed pages to its free lists,
+   where they may merge into larger blocks.  Interrupts must be
+   off. */
+static void
+reclaim_zeroed (struct pool *pool)
+{
+  while (!list_empty (&pool->zeroed))
+    {
+      struct page_block *b = list_entry (list_pop_front (&pool->zeroed),
+                                         struct page_block, elem);
+      free_block (pool, b - pool->blocks, 0);
+      pool->reclaimed++;
+    }
+  pool->zeroed_cnt = 0;
+}
+
+/* Takes a free page from POOL, zeroes it, and adds it to POOL's
+   pre-zeroed pages, unless POOL already has PREZERO_MAX of them
+   or no free page.  Returns true if it zeroed a page.  The page
+   is zeroed with interrupts on; meanwhile it is on neither list
+   but still counts as free. */
+static bool
+zero_page (struct pool *pool)
+{
+  enum intr_level old_level;
+  size_t page_idx = SIZE_MAX;
+
+  old_level = intr_disable ();
+  if (pool->zeroed_cnt < PREZERO_MAX)
+    page_idx = take_block (pool, 0);
+  intr_set_level (old_level);
+  if (page_idx == SIZE_MAX)
+    return false;
+
+  memset (pool->base + PGSIZE * page_idx, 0, PGSIZE);
+
+  old_level = intr_disable ();
+  list_push_front (&pool->zeroed, &pool->blocks[page_idx].elem);
+  pool->zeroed_cnt++;
+  pool->prezeroed++;
+  intr_set_level (old_level);
+  return true;
+}
+
+/* Prints POOL's statistics: free pages and the largest block
+   they form, how many free blocks there are of each order,
+   allocation failures, and how PAL_ZERO requests were served.
+   External fragmentation is reported as the share of the pages
+   on the free lists in blocks too small for a request of
+   2**FRAG_ORDER pages, which is 0% for a freshly booted pool. */
+#define FRAG_ORDER 3
+static void
+print_pool_stats (struct pool *pool)
+{
+  size_t free_blocks[ORDER_CNT];
+  size_t free_pages, zeroed_cnt, buddy_pages, largest = 0, small_pages = 0;
+  long long allocs, failures, frag_failures;
+  long long zero_hits, zero_misses, prezeroed, reclaimed;
+  enum intr_level old_level;
+  int order;
+
+  /* Take a consistent snapshot. */
+  old_level = intr_disable ();
+  memcpy (free_blocks, pool->free_blocks, sizeof free_blocks);
+  free_pages = pool->free_pages;
+  zeroed_cnt = pool->zeroed_cnt;
+  allocs = pool->allocs;
+  failures = pool->failures;
+  frag_failures = pool->frag_failures;
+  zero_hits = pool->zero_hits;
+  zero_misses = pool->zero_misses;
+  prezeroed = pool->prezeroed;
+  reclaimed = pool->reclaimed;
+  intr_set_level (old_level);
+  buddy_pages = free_pages - zeroed_cnt;
+
+  for (order = 0; order < ORDER_CNT; order++)
+    if (free_blocks[order] > 0)
+      {
+        largest = (size_t) 1 << order;
+        if (order < FRAG_ORDER)
+          small_pages += free_blocks[order] << order;
+      }
+
+  printf ("Palloc: %s: %zu of %zu pages free, largest free block "
+          "%zu pages, %zu%% of free pages in blocks under %d pages\n",
+          pool->name, free_pages, pool->page_cnt, largest,
+          buddy_pages > 0 ? small_pages * 100 / buddy_pages : 0,
+          1 << FRAG_ORDER);
+  printf ("Palloc: %s: %lld allocations, %lld failed "
+          "(%lld despite enough free pages)\n", pool->name,
+          allocs, failures, frag_failures);
+  printf ("Palloc: %s: free blocks by order:", pool->name);
+  for (order = 0; order < ORDER_CNT; order++)
+    if (free_blocks[order] > 0)
+      printf (" %d:%zu", order, free_blocks[order]);
+  printf ("\n");
+  printf ("Palloc: %s: %zu pages pre-zeroed, %lld PAL_ZERO hits, "
+          "%lld misses, %lld pages zeroed while idle, %lld reclaimed\n",
+          pool->name, zeroed_cnt, zero_hits, zero_misses, prezeroed,
+          reclaimed);
+}
@@ -0,0 +1,188 @@
+#include "threads/profile.h"
+#include <debug.h>
+#include <hash.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/interrupt.h"
+#include "threads/loader.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+#include "devices/serial.h"
+
+/* If true, sample the interrupted eip at each timer tick.
+   Controlled by kernel command-line option "-profile". */
+bool profile_enabled;
+
+/* If true, also sample call stacks.
+   Controlled by kernel command-line option "-profile=stack". */
+bool profile_stacks;
+
+/* Histogram of sampled kernel eips, an open-addressed hash
+   table keyed by address. */
+struct pc_count
+  {
+    uint32_t pc;                /* Sampled eip, or 0 if unused. */
+    unsigned count;             /* Number of samples. */
+  };
+#define PC_PAGES 8
+#define PC_CNT (PC_PAGES * PGSIZE / sizeof (struct pc_count))
+static struct pc_count *pc_table;
+
+/* Histogram of sampled call stacks, an open-addressed hash table
+   keyed by the whole stack.  FRAMES[0] is the sampled eip and
+   each later frame is a return address into its caller; unused
+   frames are 0. */
+#define PROFILE_DEPTH 8
+struct stack_count
+  {
+    uint32_t frames[PROFILE_DEPTH]; /* Call stack, innermost first. */
+    unsigned count;             /* Number of samples, 0 if unused. */
+  };
+#define STACK_PAGES 8
+#define STACK_CNT (STACK_PAGES * PGSIZE / sizeof (struct stack_count))
+static struct stack_count *stack_table;
+
+/* Statistics. */
+static long long samples;       /* Timer ticks sampled. */
+static long long user_samples;  /* ...of which in user mode. */
+static long long dropped;       /* Samples lost to full tables. */
+
+static bool count_pc (uint32_t pc);
+static void count_stack (const struct intr_frame *);
+
+/* Allocates the sample tables, if profiling is enabled. */
+void
+profile_init (void)
+{
+  if (!profile_enabled)
+    return;
+
+  pc_table = palloc_get_multiple (PAL_ASSERT | PAL_ZERO, PC_PAGES);
+  if (profile_stacks)
+    stack_table = palloc_get_multiple (PAL_ASSERT | PAL_ZERO, STACK_PAGES);
+}
+
+/* Records a sample of the code interrupted by the timer, whose
+   state is in F.  Called by the timer interrupt handler. */
+void
+profile_sample (const struct intr_frame *f)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (pc_table == NULL)
+    return;
+
+  samples++;
+  if (f->cs != SEL_KCSEG)
+    {
+      user_samples++;
+      return;
+    }
+
+  if (!count_pc ((uint32_t) f->eip))
+    dropped++;
+  if (stack_table != NULL)
+    count_stack (f);
+}
+
+/* Writes the sample counts to the serial port, one per line,
+   for utils/profile. */
+void
+profile_dump (void)
+{
+  size_t i;
+
+  if (pc_table == NULL)
+    return;
+
+  serial_printf ("Profile: %lld samples, %lld in user mode, %lld dropped\n",
+                 samples, user_samples, dropped);
+  for (i = 0; i < PC_CNT; i++)
+    if (pc_table[i].count != 0)
+      serial_printf ("Profile: pc 0x%08"PRIx32" %u\n",
+                     pc_table[i].pc, pc_table[i].count);
+
+  if (stack_table != NULL)
+    for (i = 0; i < STACK_CNT; i++)
+      {
+        const struct stack_count *s = &stack_table[i];
+        char line[128];
+        size_t len;
+        int d;
+
+        if (s->count == 0)
+          continue;
+        len = snprintf (line, sizeof line, "Profile: stack %u", s->count);
+        for (d = 0; d < PROFILE_DEPTH && s->frames[d] != 0; d++)
+          len += snprintf (line + len, sizeof line - len, " 0x%08"PRIx32,
+                           s->frames[d]);
+        serial_printf ("%s\n", line);
+      }
+  serial_flush ();
+}
+
+/* Counts a sample at PC.  Returns false if the table is full. */
+static bool
+count_pc (uint32_t pc)
+{
+  size_t i = hash_int (pc) % PC_CNT;
+  size_t probes;
+
+  for (probes = 0; probes < PC_CNT; probes++)
+    {
+      struct pc_count *c = &pc_table[i];
+      if (c->pc == pc || c->count == 0)
+        {
+          c->pc = pc;
+          c->count++;
+          return true;
+        }
+      i = (i + 1) % PC_CNT;
+    }
+  return false;
+}
+
+/* Counts a sample of the call stack of the kernel code
+   interrupted with state F, found by following the saved frame
+   pointers.  The walk stops at the first frame pointer that
+   leaves the interrupted thread's stack page or does not move up
+   the stack, so a function built without a frame pointer ends
+   the stack early rather than producing garbage. */
+static void
+count_stack (const struct intr_frame *f)
+{
+  uint32_t frames[PROFILE_DEPTH];
+  uintptr_t page = (uintptr_t) pg_round_down (f);
+  uintptr_t ebp = f->ebp;
+  size_t i, probes;
+  int depth = 0;
+
+  memset (frames, 0, sizeof frames);
+  frames[depth++] = (uint32_t) f->eip;
+  while (depth < PROFILE_DEPTH
+         && ebp >= page && ebp <= page + PGSIZE - 8 && ebp % 4 == 0)
+    {
+      const uint32_t *fp = (const uint32_t *) ebp;
+      if (fp[1] == 0)
+        break;
+      frames[depth++] = fp[1];
+      if (fp[0] <= ebp)
+        break;
+      ebp = fp[0];
+    }
+
+  i = hash_bytes (frames, sizeof frames) % STACK_CNT;
+  for (probes = 0; probes < STACK_CNT; probes++)
+    {
+      struct stack_count *s = &stack_table[i];
+      if (s->count == 0 || !memcmp (s->frames, frames, sizeof frames))
+        {
+          memcpy (s->frames, frames, sizeof frames);
+          s->count++;
+          return;
+        }
+      i = (i + 1) % STACK_CNT;
+    }
+  dropped++;
+}
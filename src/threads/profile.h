@@ -0,0 +1,25 @@
+#ifndef THREADS_PROFILE_H
+#define THREADS_PROFILE_H
+
+#include <stdbool.h>
+
+struct intr_frame;
+
+/* Sampling kernel profiler.
+
+   When enabled by kernel command-line option "-profile", the
+   timer interrupt handler samples the interrupted instruction
+   pointer at each tick and counts it in a histogram keyed by
+   address.  With "-profile=stack" it also walks the interrupted
+   code's frame pointers and counts each distinct call stack.
+   profile_dump() writes the counts to the serial port at
+   shutdown; utils/profile symbolizes them against kernel.o into
+   a flat profile and a call graph. */
+extern bool profile_enabled;
+extern bool profile_stacks;
+
+void profile_init (void);
+void profile_sample (const struct intr_frame *);
+void profile_dump (void);
+
+#endif /* threads/profile.h */
@@ -0,0 +1,306 @@
+#include "threads/slab.h"
+#include <debug.h>
+#include <round.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/interrupt.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+
+/* Object caches.  See slab.h for an overview.
+
+   A slab is one page.  It starts with a struct slab, followed by
+   one free-list link per object, then the color padding, then
+   the objects themselves.  Keeping the free-list links outside
+   the objects means that a free object keeps its constructed
+   state intact.
+
+   The caches are protected by disabling interrupts, as in the
+   page allocator, rather than by a lock: the critical sections
+   are a few list operations, and it lets objects be freed with
+   interrupts off.  Creating a slab, which runs the constructor
+   on each of its objects, happens with interrupts on. */
+
+/* Magic number for detecting slab corruption. */
+#define SLAB_MAGIC 0x51ab51ab
+
+/* Alignment of objects within a slab. */
+#define SLAB_ALIGN 8
+
+/* Color offsets are multiples of this many bytes, the size of a
+   cache line on the processors Pintos targets. */
+#define SLAB_COLOR 32
+
+/* Wholly free slabs kept by a cache before it frees slabs back
+   to the page allocator. */
+#define SLAB_EMPTY_MAX 1
+
+/* A slab, at the start of its page. */
+struct slab
+  {
+    unsigned magic;             /* Always set to SLAB_MAGIC. */
+    struct kmem_cache *cache;   /* Owning cache. */
+    struct list_elem elem;      /* In one of the cache's slab lists. */
+    uint8_t *objs;              /* First object. */
+    size_t in_use;              /* Objects allocated. */
+    int free_head;              /* Index of first free object, or -1. */
+    int16_t free_next[];        /* Next free object after each, or -1. */
+  };
+
+/* All caches, for statistics. */
+static struct list all_caches;
+
+static struct slab *slab_create (struct kmem_cache *);
+static struct slab *obj_to_slab (struct kmem_cache *, void *);
+
+/* Initializes the list of object caches. */
+void
+slab_init (void)
+{
+  list_init (&all_caches);
+}
+
+/* Initializes cache C for objects of SIZE bytes, to be called
+   NAME in statistics.  If CTOR is nonnull, it constructs each
+   object when its slab is created. */
+void
+kmem_cache_init (struct kmem_cache *c, const char *name, size_t size,
+                 kmem_ctor *ctor)
+{
+  size_t obj_cnt;
+
+  ASSERT (c != NULL);
+  ASSERT (size > 0);
+
+  c->name = name;
+  c->obj_size = size;
+  c->stride = ROUND_UP (size, SLAB_ALIGN);
+  c->ctor = ctor;
+
+  /* Fit as many objects as possible in a page, then give the
+     space left over to coloring. */
+  obj_cnt = (PGSIZE - sizeof (struct slab))
+            / (c->stride + sizeof (int16_t));
+  while (obj_cnt > 0
+         && ROUND_UP (sizeof (struct slab) + obj_cnt * sizeof (int16_t),
+                      SLAB_ALIGN) + obj_cnt * c->stride > PGSIZE)
+    obj_cnt--;
+  if (obj_cnt == 0)
+    PANIC ("%s: %zu-byte objects do not fit in a slab", name, size);
+  c->obj_cnt = obj_cnt;
+  c->header_size = ROUND_UP (sizeof (struct slab)
+                             + obj_cnt * sizeof (int16_t), SLAB_ALIGN);
+  c->color_max = ROUND_DOWN (PGSIZE - c->header_size - obj_cnt * c->stride,
+                             SLAB_COLOR);
+  c->color_next = 0;
+
+  list_init (&c->partial);
+  list_init (&c->full);
+  list_init (&c->empty);
+  c->empty_cnt = 0;
+
+  c->in_use = c->peak = c->slab_cnt = 0;
+  c->allocs = c->slab_creates = c->failures = 0;
+
+  list_push_back (&all_caches, &c->cache_elem);
+}
+
+/* Obtains and returns an object from cache C.  Returns a null
+   pointer if memory is not available. */
+void *
+kmem_cache_alloc (struct kmem_cache *c)
+{
+  enum intr_level old_level;
+  struct slab *s;
+  void *obj;
+
+  old_level = intr_disable ();
+  c->allocs++;
+  if (list_empty (&c->partial) && list_empty (&c->empty))
+    {
+      intr_set_level (old_level);
+      s = slab_create (c);
+      old_level = intr_disable ();
+      if (s == NULL)
+        {
+          c->failures++;
+          intr_set_level (old_level);
+          return NULL;
+        }
+      list_push_front (&c->empty, &s->elem);
+      c->empty_cnt++;
+      c->slab_cnt++;
+    }
+
+  /* Prefer a partially used slab, leaving free slabs free. */
+  if (!list_empty (&c->partial))
+    s = list_entry (list_front (&c->partial), struct slab, elem);
+  else
+    {
+      s = list_entry (list_pop_front (&c->empty), struct slab, elem);
+      c->empty_cnt--;
+      list_push_front (&c->partial, &s->elem);
+    }
+
+  ASSERT (s->free_head >= 0);
+  obj = s->objs + s->free_head * c->stride;
+  s->free_head = s->free_next[s->free_head];
+  if (++s->in_use == c->obj_cnt)
+    {
+      list_remove (&s->elem);
+      list_push_front (&c->full, &s->elem);
+    }
+
+  if (++c->in_use > c->peak)
+    c->peak = c->in_use;
+  intr_set_level (old_level);
+
+  return obj;
+}
+
+/* Returns OBJ, which must have been obtained from cache C, to
+   the cache.  If C has a constructor, OBJ must be in its
+   constructed state.  Does nothing if OBJ is a null pointer. */
+void
+kmem_cache_free (struct kmem_cache *c, void *obj)
+{
+  enum intr_level old_level;
+  struct slab *s;
+  bool was_full;
+  int idx;
+
+  if (obj == NULL)
+    return;
+
+  s = obj_to_slab (c, obj);
+  idx = ((uint8_t *) obj - s->objs) / c->stride;
+
+#ifndef NDEBUG
+  /* Clear the object to help detect use-after-free bugs, unless
+     that would destroy its constructed state. */
+  if (c->ctor == NULL)
+    memset (obj, 0xcc, c->obj_size);
+#endif
+
+  old_level = intr_disable ();
+  ASSERT (s->in_use > 0);
+  was_full = s->in_use == c->obj_cnt;
+  s->free_next[idx] = s->free_head;
+  s->free_head = idx;
+  s->in_use--;
+  c->in_use--;
+
+  if (s->in_use == 0)
+    {
+      /* Keep a few free slabs to absorb allocations that come
+         and go around a slab boundary; free the rest. */
+      list_remove (&s->elem);
+      if (c->empty_cnt < SLAB_EMPTY_MAX)
+        {
+          list_push_front (&c->empty, &s->elem);
+          c->empty_cnt++;
+          s = NULL;
+        }
+      else
+        c->slab_cnt--;
+    }
+  else
+    {
+      if (was_full)
+        {
+          list_remove (&s->elem);
+          list_push_front (&c->partial, &s->elem);
+        }
+      s = NULL;
+    }
+  intr_set_level (old_level);
+
+  if (s != NULL)
+    {
+      s->magic = 0;
+      palloc_free_page (s);
+    }
+}
+
+/* Prints statistics for each cache: objects in use, now and at
+   peak, and the slabs holding them. */
+void
+slab_print_stats (void)
+{
+  struct list_elem *e;
+
+  for (e = list_begin (&all_caches); e != list_end (&all_caches);
+       e = list_next (e))
+    {
+      struct kmem_cache *c = list_entry (e, struct kmem_cache, cache_elem);
+      enum intr_level old_level = intr_disable ();
+      size_t in_use = c->in_use, peak = c->peak, slab_cnt = c->slab_cnt;
+      size_t full_cnt = list_size (&c->full);
+      size_t empty_cnt = c->empty_cnt;
+      long long allocs = c->allocs, slab_creates = c->slab_creates;
+      long long failures = c->failures;
+      intr_set_level (old_level);
+
+      printf ("Slab: %s: %zu-byte objects, %zu per slab, "
+              "%zu in use (peak %zu) of %zu\n",
+              c->name, c->obj_size, c->obj_cnt, in_use, peak,
+              slab_cnt * c->obj_cnt);
+      printf ("Slab: %s: %zu slabs (%zu full, %zu partial, %zu empty), "
+              "%lld allocs, %lld slabs created, %lld failures\n",
+              c->name, slab_cnt, full_cnt, slab_cnt - full_cnt - empty_cnt,
+              empty_cnt, allocs, slab_creates, failures);
+    }
+}
+
+/* Obtains a page from the page allocator and makes it a slab for
+   cache C, with all its objects free and constructed.  Returns a
+   null pointer if no page is available. */
+static struct slab *
+slab_create (struct kmem_cache *c)
+{
+  enum intr_level old_level;
+  struct slab *s;
+  size_t color;
+  size_t i;
+
+  s = palloc_get_page (0);
+  if (s == NULL)
+    return NULL;
+
+  old_level = intr_disable ();
+  color = c->color_next;
+  c->color_next = color + SLAB_COLOR <= c->color_max ? color + SLAB_COLOR : 0;
+  c->slab_creates++;
+  intr_set_level (old_level);
+
+  s->magic = SLAB_MAGIC;
+  s->cache = c;
+  s->objs = (uint8_t *) s + c->header_size + color;
+  s->in_use = 0;
+  s->free_head = 0;
+  for (i = 0; i < c->obj_cnt; i++)
+    {
+      s->free_next[i] = i + 1 < c->obj_cnt ? (int) i + 1 : -1;
+      if (c->ctor != NULL)
+        c->ctor (s->objs + i * c->stride);
+    }
+  return s;
+}
+
+/* Returns the slab that OBJ, an object of cache C, is in. */
+static struct slab *
+obj_to_slab (struct kmem_cache *c, void *obj)
+{
+  struct slab *s = pg_round_down (obj);
+
+  /* Check that the slab is valid and belongs to C. */
+  ASSERT (s->magic == SLAB_MAGIC);
+  ASSERT (s->cache == c);
+
+  /* Check that OBJ is properly aligned for the slab. */
+  ASSERT ((uint8_t *) obj >= s->objs);
+  ASSERT (((uint8_t *) obj - s->objs) % c->stride == 0);
+
+  return s;
+}
@@ -0,0 +1,64 @@
+#ifndef THREADS_SLAB_H
+#define THREADS_SLAB_H
+
+#include <list.h>
+#include <stddef.h>
+
+/* Object caches, after Bonwick, "The Slab Allocator: An
+   Object-Caching Kernel Memory Allocator" (USENIX 1994).
+
+   A cache hands out objects of a single size carved from
+   page-sized "slabs".  If the cache has a constructor, it runs
+   once for each object when its slab is created, not on every
+   allocation, so callers must free objects in their constructed
+   state (e.g. with any locks in them released) and may rely on
+   that state when they allocate.
+
+   Each cache keeps its slabs on three lists, by whether all,
+   some, or none of their objects are in use.  Allocation takes
+   from a partially used slab first, so that memory fills up
+   densely, and a cache keeps one wholly free slab in reserve
+   before it gives pages back to the page allocator.  Successive
+   slabs start their objects at different offsets ("colors")
+   within the page, so that the same object in different slabs
+   does not always fall into the same cache lines.
+
+   Objects must fit in a page along with the slab header. */
+
+/* Constructor, run on each object of a new slab. */
+typedef void kmem_ctor (void *obj);
+
+/* An object cache.  All members are private to slab.c. */
+struct kmem_cache
+  {
+    const char *name;           /* Name, for statistics. */
+    size_t obj_size;            /* Object size requested. */
+    size_t stride;              /* Distance between objects in a slab. */
+    size_t obj_cnt;             /* Objects per slab. */
+    size_t header_size;         /* Bytes before the first color. */
+    size_t color_max;           /* Largest color offset, in bytes. */
+    size_t color_next;          /* Color offset for the next slab. */
+    kmem_ctor *ctor;            /* Constructor, or a null pointer. */
+    struct list partial;        /* Slabs with some objects in use. */
+    struct list full;           /* Slabs with all objects in use. */
+    struct list empty;          /* Slabs with no objects in use. */
+    size_t empty_cnt;           /* Number of slabs in EMPTY. */
+    struct list_elem cache_elem; /* Element in list of all caches. */
+
+    /* Statistics. */
+    size_t in_use;              /* Objects allocated. */
+    size_t peak;                /* Maximum IN_USE. */
+    size_t slab_cnt;            /* Slabs in the three lists. */
+    long long allocs;           /* Calls to kmem_cache_alloc(). */
+    long long slab_creates;     /* Slabs obtained from palloc. */
+    long long failures;         /* Allocations that failed. */
+  };
+
+void slab_init (void);
+void kmem_cache_init (struct kmem_cache *, const char *name, size_t size,
+                      kmem_ctor *);
+void *kmem_cache_alloc (struct kmem_cache *);
+void kmem_cache_free (struct kmem_cache *, void *);
+void slab_print_stats (void);
+
+#endif /* threads/slab.h */
@@ -31,6 +31,32 @@
 #include <string.h>
 #include "threads/interrupt.h"
 #include "threads/thread.h"
+#include "threads/trace.h"
+#include "devices/timer.h"
+
+/* Maximum depth of a chain of lock holders that priority
+   donation will follow.  Bounds the work done in lock_acquire()
+   and protects against cycles from buggy lock usage. */
+#define DONATION_DEPTH_MAX 8
+
+static bool thread_priority_less (const struct list_elem *,
+                                  const struct list_elem *, void *aux);
+
+bool synch_profile;
+
+/* Contention statistics, one entry per initialization site,
+   hashed by the address of the site string.  Accessed with
+   interrupts off. */
+#define SYNCH_CLASS_CNT 128     /* Max. # of sites; power of 2. */
+static struct synch_class synch_classes[SYNCH_CLASS_CNT];
+static int synch_class_cnt;     /* # of entries in use. */
+
+static struct synch_class *synch_class_get (const char *site,
+                                            const char *type);
+static void synch_account_wait (struct synch_class *, bool contended,
+                                int64_t start);
+static void synch_account_hold (struct synch_class *, int64_t start);
+
 
 /* Initializes semaphore SEMA to VALUE.  A semaphore is a
    nonnegative integer along with two atomic operators for
@@ -40,14 +66,20 @@
      decrement it.
 
    - up or "V": increment the value (and wake up one waiting
-     thread, if any). */
+     thread, if any).
+
+   SITE, supplied by the sema_init() macro, names the place in
+   the source where SEMA is initialized, to which its contention
+   statistics are charged.  A null SITE exempts SEMA from
+   profiling. */
 void
-sema_init (struct semaphore *sema, unsigned value) 
+sema_init_at (struct semaphore *sema, unsigned value, const char *site) 
 {
   ASSERT (sema != NULL);
 
   sema->value = value;
   list_init (&sema->waiters);
+  sema->class = site != NULL ? synch_class_get (site, "sema") : NULL;
 }
 
 /* Down or "P" operation on a semaphore.  Waits for SEMA's value
@@ -61,17 +93,24 @@ void
 sema_down (struct semaphore *sema) 
 {
   enum intr_level old_level;
+  bool contended;
+  int64_t start = 0;
 
   ASSERT (sema != NULL);
   ASSERT (!intr_context ());
 
   old_level = intr_disable ();
+  contended = sema->value == 0;
+  if (sema->class != NULL && contended)
+    start = timer_nanotime ();
   while (sema->value == 0) 
     {
       list_push_back (&sema->waiters, &thread_current ()->elem);
       thread_block ();
     }
   sema->value--;
+  if (sema->class != NULL)
+    synch_account_wait (sema->class, contended, start);
   intr_set_level (old_level);
 }
 
@@ -102,7 +141,12 @@ sema_try_down (struct semaphore *sema)
 }
 
 /* Up or "V" operation on a semaphore.  Increments SEMA's value
-   and wakes up one thread of those waiting for SEMA, if any.
+   and wakes up the highest-priority thread of those waiting for
+   SEMA, if any.  If that thread has a higher priority than the
+   running thread, the running thread yields to it.
+
+   Waiters are kept unsorted and searched here, because priority
+   donation can change a waiter's priority while it sleeps.
 
    This function may be called from an interrupt handler. */
 void
@@ -114,12 +158,27 @@ sema_up (struct semaphore *sema)
 
   old_level = intr_disable ();
   if (!list_empty (&sema->waiters)) 
-    thread_unblock (list_entry (list_pop_front (&sema->waiters),
-                                struct thread, elem));
+    {
+      struct list_elem *e = list_max (&sema->waiters,
+                                      thread_priority_less, NULL);
+      list_remove (e);
+      thread_unblock (list_entry (e, struct thread, elem));
+    }
   sema->value++;
+  thread_preempt ();
   intr_set_level (old_level);
 }
 
+/* Returns true if the thread owning list element A has a lower
+   priority than the thread owning list element B. */
+static bool
+thread_priority_less (const struct list_elem *a, const struct list_elem *b,
+                      void *aux UNUSED)
+{
+  return (list_entry (a, struct thread, elem)->priority
+          < list_entry (b, struct thread, elem)->priority);
+}
+
 static void sema_test_helper (void *sema_);
 
 /* Self-test for semaphores that makes control "ping-pong"
@@ -171,20 +230,30 @@ sema_test_helper (void *sema_)
    another one "up" it, but with a lock the same thread must both
    acquire and release it.  When these restrictions prove
    onerous, it's a good sign that a semaphore should be used,
-   instead of a lock. */
+   instead of a lock.
+
+   As with semaphores, SITE names where LOCK is initialized, for
+   contention statistics, and a null SITE exempts LOCK from
+   profiling. */
 void
-lock_init (struct lock *lock)
+lock_init_at (struct lock *lock, const char *site)
 {
   ASSERT (lock != NULL);
 
   lock->holder = NULL;
-  sema_init (&lock->semaphore, 1);
+  sema_init_at (&lock->semaphore, 1, NULL);
+  lock->class = site != NULL ? synch_class_get (site, "lock") : NULL;
 }
 
 /* Acquires LOCK, sleeping until it becomes available if
    necessary.  The lock must not already be held by the current
    thread.
 
+   While we wait, our priority is donated to the lock's holder
+   and, if the holder is itself waiting for a lock, on down the
+   chain of holders, so that none of them is starved by threads
+   of intermediate priority.
+
    This function may sleep, so it must not be called within an
    interrupt handler.  This function may be called with
    interrupts disabled, but interrupts will be turned back on if
@@ -192,12 +261,46 @@ lock_init (struct lock *lock)
 void
 lock_acquire (struct lock *lock)
 {
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
+  bool contended;
+  int64_t start = 0;
+
   ASSERT (lock != NULL);
   ASSERT (!intr_context ());
   ASSERT (!lock_held_by_current_thread (lock));
 
+  old_level = intr_disable ();
+  contended = lock->holder != NULL;
+  if (lock->class != NULL && contended)
+    start = timer_nanotime ();
+  if (contended)
+    TRACE (TRACE_LOCK_BLOCK, cur->tid, lock->holder->tid, 0);
+  if (lock->holder != NULL && !thread_mlfqs)
+    {
+      struct lock *l = lock;
+      int depth;
+
+      cur->waiting_lock = lock;
+      for (depth = 0; l != NULL && l->holder != NULL
+             && depth < DONATION_DEPTH_MAX; depth++)
+        {
+          thread_donate_priority (l->holder, cur->priority);
+          l = l->holder->waiting_lock;
+        }
+    }
+
   sema_down (&lock->semaphore);
-  lock->holder = thread_current ();
+
+  cur->waiting_lock = NULL;
+  lock->holder = cur;
+  list_push_back (&cur->held_locks, &lock->elem);
+  if (lock->class != NULL)
+    {
+      synch_account_wait (lock->class, contended, start);
+      lock->acquired_at = timer_nanotime ();
+    }
+  intr_set_level (old_level);
 }
 
 /* Tries to acquires LOCK and returns true if successful or false
@@ -216,23 +319,46 @@ lock_try_acquire (struct lock *lock)
 
   success = sema_try_down (&lock->semaphore);
   if (success)
-    lock->holder = thread_current ();
+    {
+      enum intr_level old_level = intr_disable ();
+      lock->holder = thread_current ();
+      list_push_back (&lock->holder->held_locks, &lock->elem);
+      if (lock->class != NULL)
+        {
+          synch_account_wait (lock->class, false, 0);
+          lock->acquired_at = timer_nanotime ();
+        }
+      intr_set_level (old_level);
+    }
   return success;
 }
 
 /* Releases LOCK, which must be owned by the current thread.
 
+   Any priority donated to us through LOCK is given up, but
+   donations through other locks we still hold are kept.  If that
+   leaves a higher-priority thread ready to run, we yield to it.
+
    An interrupt handler cannot acquire a lock, so it does not
    make sense to try to release a lock within an interrupt
    handler. */
 void
 lock_release (struct lock *lock) 
 {
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
+
   ASSERT (lock != NULL);
   ASSERT (lock_held_by_current_thread (lock));
 
+  old_level = intr_disable ();
+  if (lock->class != NULL)
+    synch_account_hold (lock->class, lock->acquired_at);
+  list_remove (&lock->elem);
   lock->holder = NULL;
+  thread_update_priority (cur);
   sema_up (&lock->semaphore);
+  intr_set_level (old_level);
 }
 
 /* Returns true if the current thread holds LOCK, false
@@ -251,8 +377,12 @@ struct semaphore_elem
   {
     struct list_elem elem;              /* List element. */
     struct semaphore semaphore;         /* This semaphore. */
+    struct thread *thread;              /* Thread waiting on it. */
   };
 
+static bool waiter_priority_less (const struct list_elem *,
+                                  const struct list_elem *, void *aux);
+
 /* Initializes condition variable COND.  A condition variable
    allows one piece of code to signal a condition and cooperating
    code to receive the signal and act upon it. */
@@ -294,7 +424,10 @@ cond_wait (struct condition *cond, struct lock *lock)
   ASSERT (!intr_context ());
   ASSERT (lock_held_by_current_thread (lock));
   
-  sema_init (&waiter.semaphore, 0);
+  /* Waiting for a condition is not contention, so keep it out
+     of the statistics. */
+  sema_init_at (&waiter.semaphore, 0, NULL);
+  waiter.thread = thread_current ();
   list_push_back (&cond->waiters, &waiter.elem);
   lock_release (lock);
   sema_down (&waiter.semaphore);
@@ -302,8 +435,9 @@ cond_wait (struct condition *cond, struct lock *lock)
 }
 
 /* If any threads are waiting on COND (protected by LOCK), then
-   this function signals one of them to wake up from its wait.
-   LOCK must be held before calling this function.
+   this function signals the highest-priority one of them to wake
+   up from its wait.  LOCK must be held before calling this
+   function.
 
    An interrupt handler cannot acquire a lock, so it does not
    make sense to try to signal a condition variable within an
@@ -317,8 +451,22 @@ cond_signal (struct condition *cond, struct lock *lock UNUSED)
   ASSERT (lock_held_by_current_thread (lock));
 
   if (!list_empty (&cond->waiters)) 
-    sema_up (&list_entry (list_pop_front (&cond->waiters),
-                          struct semaphore_elem, elem)->semaphore);
+    {
+      struct list_elem *e = list_max (&cond->waiters,
+                                      waiter_priority_less, NULL);
+      list_remove (e);
+      sema_up (&list_entry (e, struct semaphore_elem, elem)->semaphore);
+    }
+}
+
+/* Returns true if the thread waiting on condition variable
+   waiter A has a lower priority than the one waiting on B. */
+static bool
+waiter_priority_less (const struct list_elem *a, const struct list_elem *b,
+                      void *aux UNUSED)
+{
+  return (list_entry (a, struct semaphore_elem, elem)->thread->priority
+          < list_entry (b, struct semaphore_elem, elem)->thread->priority);
 }
 
 /* Wakes up all threads, if any, waiting on COND (protected by
@@ -336,3 +484,466 @@ cond_broadcast (struct condition *cond, struct lock *lock)
   while (!list_empty (&cond->waiters))
     cond_signal (cond, lock);
 }
+
+/* Initializes RW as a reader-writer lock that is not held,
+   using POLICY to decide between contending readers and
+   writers.
+
+   Any number of threads may hold a reader-writer lock for
+   reading at once, or a single thread may hold it for writing.
+   Like a lock, it must be released by the thread that acquired
+   it, and it is not recursive.  Threads waiting for a
+   reader-writer lock do not donate their priority to its
+   holders.
+
+   SITE names where RW is initialized.  Contention statistics
+   are kept for RW as a whole, under SITE, counting the time
+   threads wait for its holders as well as for its internal
+   lock. */
+void
+rwlock_init_at (struct rwlock *rw, enum rwlock_policy policy,
+                const char *site)
+{
+  ASSERT (rw != NULL);
+
+  lock_init_at (&rw->lock, NULL);
+  rw->class = site != NULL ? synch_class_get (site, "rw") : NULL;
+  rw->write_acquired_at = 0;
+  rw->policy = policy;
+  rw->readers = 0;
+  rw->writer = NULL;
+  rw->waiting_readers = 0;
+  rw->waiting_writers = 0;
+  rw->read_grants = 0;
+  rw->upgrading = false;
+  cond_init (&rw->can_read);
+  cond_init (&rw->can_write);
+}
+
+/* Returns true if a thread that is just arriving to read RW
+   must wait.  RW's internal lock must be held. */
+static bool
+rwlock_read_must_wait (const struct rwlock *rw)
+{
+  return (rw->writer != NULL || rw->upgrading
+          || (rw->policy != RWLOCK_PREFER_READERS
+              && rw->waiting_writers > 0));
+}
+
+/* Returns true if a thread already waiting to read RW must keep
+   waiting.  Differs from rwlock_read_must_wait() in that under
+   RWLOCK_FAIR, a waiting reader with a grant goes ahead of
+   waiting writers.  RW's internal lock must be held. */
+static bool
+rwlock_waiting_reader_must_wait (const struct rwlock *rw)
+{
+  if (rw->writer != NULL || rw->upgrading)
+    return true;
+  switch (rw->policy)
+    {
+    case RWLOCK_PREFER_READERS:
+      return false;
+    case RWLOCK_PREFER_WRITERS:
+      return rw->waiting_writers > 0;
+    default:
+      return rw->waiting_writers > 0 && rw->read_grants == 0;
+    }
+}
+
+/* Returns true if a thread that wants to write RW must wait.
+   RW's internal lock must be held. */
+static bool
+rwlock_write_must_wait (const struct rwlock *rw)
+{
+  return (rw->writer != NULL || rw->readers > 0 || rw->upgrading
+          || rw->read_grants > 0);
+}
+
+/* Wakes whoever may proceed after RW stopped being held for
+   writing.  Under RWLOCK_FAIR, the readers waiting now are
+   granted entry ahead of any waiting writer.  RW's internal lock
+   must be held. */
+static void
+rwlock_wake_after_write (struct rwlock *rw)
+{
+  if (rw->policy == RWLOCK_FAIR)
+    rw->read_grants = rw->waiting_readers;
+  if (rw->waiting_readers > 0)
+    cond_broadcast (&rw->can_read, &rw->lock);
+  if (rw->waiting_writers > 0 && rw->readers == 0)
+    cond_signal (&rw->can_write, &rw->lock);
+}
+
+/* Begins an acquisition of RW, by acquiring its internal lock.
+   Returns the time the acquisition started, if RW is profiled,
+   and sets *CONTENDED to whether the internal lock was held. */
+static int64_t
+rwlock_begin (struct rwlock *rw, bool *contended)
+{
+  int64_t start = 0;
+
+  *contended = rw->lock.holder != NULL;
+  if (rw->class != NULL)
+    start = timer_nanotime ();
+  lock_acquire (&rw->lock);
+  return start;
+}
+
+/* Records in RW's statistics an acquisition that started at
+   START and waited if CONTENDED is true.  If WRITE is true, RW
+   is now held for writing.  RW's internal lock must be held. */
+static void
+rwlock_account (struct rwlock *rw, bool contended, int64_t start,
+                bool write)
+{
+  enum intr_level old_level;
+
+  if (rw->class == NULL)
+    return;
+  old_level = intr_disable ();
+  synch_account_wait (rw->class, contended, start);
+  if (write)
+    rw->write_acquired_at = timer_nanotime ();
+  intr_set_level (old_level);
+}
+
+/* Records in RW's statistics the end of a hold for writing.
+   RW's internal lock must be held. */
+static void
+rwlock_account_release_write (struct rwlock *rw)
+{
+  enum intr_level old_level;
+
+  if (rw->class == NULL)
+    return;
+  old_level = intr_disable ();
+  synch_account_hold (rw->class, rw->write_acquired_at);
+  intr_set_level (old_level);
+}
+
+/* Acquires RW for reading, sleeping until it is available if
+   necessary.  The calling thread must not already hold RW.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void
+rwlock_acquire_read (struct rwlock *rw)
+{
+  bool contended;
+  int64_t start;
+
+  ASSERT (rw != NULL);
+  ASSERT (!intr_context ());
+
+  start = rwlock_begin (rw, &contended);
+  ASSERT (rw->writer != thread_current ());
+  if (rwlock_read_must_wait (rw))
+    {
+      contended = true;
+      rw->waiting_readers++;
+      do
+        cond_wait (&rw->can_read, &rw->lock);
+      while (rwlock_waiting_reader_must_wait (rw));
+      rw->waiting_readers--;
+      if (rw->read_grants > 0)
+        rw->read_grants--;
+    }
+  rw->readers++;
+  rwlock_account (rw, contended, start, false);
+  lock_release (&rw->lock);
+}
+
+/* Tries to acquire RW for reading and returns true if
+   successful or false on failure.  Does not sleep waiting for
+   RW's holders, though it may briefly wait for RW's internal
+   lock. */
+bool
+rwlock_try_acquire_read (struct rwlock *rw)
+{
+  bool success;
+
+  ASSERT (rw != NULL);
+  ASSERT (!intr_context ());
+
+  lock_acquire (&rw->lock);
+  success = !rwlock_read_must_wait (rw);
+  if (success)
+    {
+      rw->readers++;
+      rwlock_account (rw, false, 0, false);
+    }
+  lock_release (&rw->lock);
+  return success;
+}
+
+/* Releases RW, which the current thread holds for reading. */
+void
+rwlock_release_read (struct rwlock *rw)
+{
+  ASSERT (rw != NULL);
+
+  lock_acquire (&rw->lock);
+  ASSERT (rw->readers > 0);
+  rw->readers--;
+  if (rw->upgrading && rw->readers == 1)
+    cond_broadcast (&rw->can_write, &rw->lock);
+  else if (rw->readers == 0 && rw->waiting_writers > 0)
+    cond_signal (&rw->can_write, &rw->lock);
+  lock_release (&rw->lock);
+}
+
+/* Acquires RW for writing, sleeping until it is available if
+   necessary.  The calling thread must not already hold RW.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void
+rwlock_acquire_write (struct rwlock *rw)
+{
+  bool contended;
+  int64_t start;
+
+  ASSERT (rw != NULL);
+  ASSERT (!intr_context ());
+
+  start = rwlock_begin (rw, &contended);
+  ASSERT (rw->writer != thread_current ());
+  rw->waiting_writers++;
+  while (rwlock_write_must_wait (rw))
+    {
+      contended = true;
+      cond_wait (&rw->can_write, &rw->lock);
+    }
+  rw->waiting_writers--;
+  rw->writer = thread_current ();
+  rwlock_account (rw, contended, start, true);
+  lock_release (&rw->lock);
+}
+
+/* Tries to acquire RW for writing and returns true if
+   successful or false on failure.  Does not sleep waiting for
+   RW's holders, though it may briefly wait for RW's internal
+   lock. */
+bool
+rwlock_try_acquire_write (struct rwlock *rw)
+{
+  bool success;
+
+  ASSERT (rw != NULL);
+  ASSERT (!intr_context ());
+
+  lock_acquire (&rw->lock);
+  success = !rwlock_write_must_wait (rw);
+  if (success)
+    {
+      rw->writer = thread_current ();
+      rwlock_account (rw, false, 0, true);
+    }
+  lock_release (&rw->lock);
+  return success;
+}
+
+/* Releases RW, which the current thread holds for writing. */
+void
+rwlock_release_write (struct rwlock *rw)
+{
+  ASSERT (rw != NULL);
+
+  lock_acquire (&rw->lock);
+  ASSERT (rw->writer == thread_current ());
+  rwlock_account_release_write (rw);
+  rw->writer = NULL;
+  rwlock_wake_after_write (rw);
+  lock_release (&rw->lock);
+}
+
+/* Converts the current thread's read hold on RW into a write
+   hold, sleeping until the other readers have released RW.
+   Returns true if successful.  Returns false, without sleeping
+   and still holding RW for reading, if another reader is already
+   upgrading, because letting both wait for each other would
+   deadlock.  Upgrading takes precedence over all waiting
+   writers. */
+bool
+rwlock_upgrade (struct rwlock *rw)
+{
+  bool contended;
+  int64_t start;
+
+  ASSERT (rw != NULL);
+  ASSERT (!intr_context ());
+
+  start = rwlock_begin (rw, &contended);
+  ASSERT (rw->readers > 0);
+  if (rw->upgrading)
+    {
+      lock_release (&rw->lock);
+      return false;
+    }
+  rw->upgrading = true;
+  while (rw->readers > 1)
+    {
+      contended = true;
+      cond_wait (&rw->can_write, &rw->lock);
+    }
+  rw->upgrading = false;
+  rw->readers = 0;
+  rw->writer = thread_current ();
+  rwlock_account (rw, contended, start, true);
+  lock_release (&rw->lock);
+  return true;
+}
+
+/* Converts the current thread's write hold on RW into a read
+   hold, letting waiting readers in alongside it. */
+void
+rwlock_downgrade (struct rwlock *rw)
+{
+  ASSERT (rw != NULL);
+
+  lock_acquire (&rw->lock);
+  ASSERT (rw->writer == thread_current ());
+  rwlock_account_release_write (rw);
+  rw->writer = NULL;
+  rw->readers = 1;
+  rwlock_wake_after_write (rw);
+  lock_release (&rw->lock);
+}
+
+/* Returns true if the current thread holds RW for writing,
+   false otherwise.  (Whether the current thread holds RW for
+   reading is not tracked.) */
+bool
+rwlock_held_for_write (const struct rwlock *rw)
+{
+  ASSERT (rw != NULL);
+
+  return rw->writer == thread_current ();
+}
+
+/* Returns the statistics entry for SITE, creating it if
+   necessary, or a null pointer if profiling is disabled or the
+   table is full. */
+static struct synch_class *
+synch_class_get (const char *site, const char *type)
+{
+  struct synch_class *c = NULL;
+  enum intr_level old_level;
+  unsigned i;
+
+  if (!synch_profile)
+    return NULL;
+
+  old_level = intr_disable ();
+  for (i = (uintptr_t) site >> 2; ; i++)
+    {
+      c = &synch_classes[i % SYNCH_CLASS_CNT];
+      if (c->site == site)
+        break;
+      if (c->site == NULL)
+        {
+          if (synch_class_cnt < SYNCH_CLASS_CNT - 1)
+            {
+              c->site = site;
+              c->type = type;
+              synch_class_cnt++;
+            }
+          else
+            c = NULL;
+          break;
+        }
+    }
+  intr_set_level (old_level);
+
+  return c;
+}
+
+/* Records in C an acquisition that waited from START until now
+   if CONTENDED is true, or did not wait at all otherwise.  Must
+   be called with interrupts off. */
+static void
+synch_account_wait (struct synch_class *c, bool contended, int64_t start)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  c->acquisitions++;
+  if (contended)
+    {
+      int64_t wait = timer_nanotime () - start;
+
+      c->contended++;
+      c->wait_ns += wait;
+      if (wait > c->wait_max_ns)
+        c->wait_max_ns = wait;
+    }
+}
+
+/* Records in C the end of a hold that began at START.  Must be
+   called with interrupts off. */
+static void
+synch_account_hold (struct synch_class *c, int64_t start)
+{
+  int64_t hold;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  hold = timer_nanotime () - start;
+  c->hold_ns += hold;
+  if (hold > c->hold_max_ns)
+    c->hold_max_ns = hold;
+}
+
+/* Returns SITE without leading "../" components. */
+static const char *
+site_name (const char *site)
+{
+  while (site[0] == '.' && site[1] == '.' && site[2] == '/')
+    site += 3;
+  return site;
+}
+
+/* Prints the contention statistics of the initialization sites
+   whose locks and semaphores spent the most time waiting. */
+void
+synch_print_stats (void)
+{
+  enum { TOP_N = 10 };
+  struct synch_class *top[TOP_N];
+  int top_cnt = 0;
+  int i, j;
+
+  if (!synch_profile)
+    return;
+
+  /* Find the TOP_N entries with the longest total wait, by
+     insertion into a sorted array. */
+  for (i = 0; i < SYNCH_CLASS_CNT; i++)
+    {
+      struct synch_class *c = &synch_classes[i];
+      if (c->site == NULL || c->acquisitions == 0)
+        continue;
+      for (j = top_cnt; j > 0 && top[j - 1]->wait_ns < c->wait_ns; j--)
+        if (j < TOP_N)
+          top[j] = top[j - 1];
+      if (j < TOP_N)
+        {
+          top[j] = c;
+          if (top_cnt < TOP_N)
+            top_cnt++;
+        }
+    }
+
+  printf ("Synch: top %d of %d sites by wait time (times in us):\n",
+          top_cnt, synch_class_cnt);
+  printf ("  %-28s %4s %9s %9s %9s %7s %9s %7s\n", "site", "type",
+          "acquires", "contended", "wait", "max", "hold", "max");
+  for (i = 0; i < top_cnt; i++)
+    {
+      struct synch_class *c = top[i];
+      printf ("  %-28s %4s %9lld %9lld %9lld %7lld %9lld %7lld\n",
+              site_name (c->site), c->type,
+              c->acquisitions, c->contended,
+              c->wait_ns / 1000, c->wait_max_ns / 1000,
+              c->hold_ns / 1000, c->hold_max_ns / 1000);
+    }
+}
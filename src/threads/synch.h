@@ -3,15 +3,46 @@
 
 #include <list.h>
 #include <stdbool.h>
+#include <stdint.h>
+
+/* If true, gather contention statistics for locks and
+   semaphores.  Controlled by kernel command-line option
+   "-lockstat". */
+extern bool synch_profile;
+
+/* Contention statistics shared by every lock, semaphore, or
+   reader-writer lock initialized at one place in the source. */
+struct synch_class
+  {
+    const char *site;           /* "FILE:LINE" of the initialization. */
+    const char *type;           /* "lock", "sema", or "rw". */
+    int64_t acquisitions;       /* # of acquisitions or downs. */
+    int64_t contended;          /* # of those that had to wait. */
+    int64_t wait_ns;            /* Total time spent waiting. */
+    int64_t wait_max_ns;        /* Longest wait. */
+    int64_t hold_ns;            /* Total time held (locks, and
+                                   rwlocks for writing). */
+    int64_t hold_max_ns;        /* Longest hold. */
+  };
+
+/* Expands to a string naming the current source line, used to
+   key contention statistics. */
+#define SYNCH_SITE SYNCH_SITE_ (__FILE__, __LINE__)
+#define SYNCH_SITE_(FILE, LINE) SYNCH_SITE__ (FILE, LINE)
+#define SYNCH_SITE__(FILE, LINE) FILE ":" #LINE
+
+void synch_print_stats (void);
 
 /* A counting semaphore. */
 struct semaphore 
   {
     unsigned value;             /* Current value. */
     struct list waiters;        /* List of waiting threads. */
+    struct synch_class *class;  /* Statistics, if profiling. */
   };
 
-void sema_init (struct semaphore *, unsigned value);
+#define sema_init(SEMA, VALUE) sema_init_at (SEMA, VALUE, SYNCH_SITE)
+void sema_init_at (struct semaphore *, unsigned value, const char *site);
 void sema_down (struct semaphore *);
 bool sema_try_down (struct semaphore *);
 void sema_up (struct semaphore *);
@@ -20,11 +51,15 @@ void sema_self_test (void);
 /* Lock. */
 struct lock 
   {
-    struct thread *holder;      /* Thread holding lock (for debugging). */
+    struct thread *holder;      /* Thread holding lock. */
     struct semaphore semaphore; /* Binary semaphore controlling access. */
+    struct list_elem elem;      /* Element in holder's held_locks. */
+    struct synch_class *class;  /* Statistics, if profiling. */
+    int64_t acquired_at;        /* When acquired, if profiling. */
   };
 
-void lock_init (struct lock *);
+#define lock_init(LOCK) lock_init_at (LOCK, SYNCH_SITE)
+void lock_init_at (struct lock *, const char *site);
 void lock_acquire (struct lock *);
 bool lock_try_acquire (struct lock *);
 void lock_release (struct lock *);
@@ -41,6 +76,51 @@ void cond_wait (struct condition *, struct lock *);
 void cond_signal (struct condition *, struct lock *);
 void cond_broadcast (struct condition *, struct lock *);
 
+/* Policies deciding who goes first when readers and writers
+   contend for a reader-writer lock. */
+enum rwlock_policy
+  {
+    RWLOCK_PREFER_READERS,      /* Readers never wait for waiting
+                                   writers.  Writers may starve. */
+    RWLOCK_PREFER_WRITERS,      /* Readers wait while any writer waits.
+                                   Readers may starve. */
+    RWLOCK_FAIR                 /* Readers arriving while a writer waits
+                                   queue behind it, but all readers
+                                   waiting when a writer releases go
+                                   before the next writer. */
+  };
+
+/* Reader-writer lock. */
+struct rwlock
+  {
+    struct lock lock;           /* Protects the members below. */
+    enum rwlock_policy policy;  /* Fairness policy. */
+    int readers;                /* # of threads holding it for reading. */
+    struct thread *writer;      /* Thread holding it for writing. */
+    int waiting_readers;        /* # of threads waiting to read. */
+    int waiting_writers;        /* # of threads waiting to write. */
+    int read_grants;            /* # of waiting readers to let in before
+                                   the next writer (RWLOCK_FAIR). */
+    bool upgrading;             /* A reader is waiting to upgrade. */
+    struct condition can_read;  /* Signaled when readers may proceed. */
+    struct condition can_write; /* Signaled when writers may proceed. */
+    struct synch_class *class;  /* Statistics, if profiling. */
+    int64_t write_acquired_at;  /* When acquired for writing, if
+                                   profiling. */
+  };
+
+#define rwlock_init(RW, POLICY) rwlock_init_at (RW, POLICY, SYNCH_SITE)
+void rwlock_init_at (struct rwlock *, enum rwlock_policy, const char *site);
+void rwlock_acquire_read (struct rwlock *);
+bool rwlock_try_acquire_read (struct rwlock *);
+void rwlock_release_read (struct rwlock *);
+void rwlock_acquire_write (struct rwlock *);
+bool rwlock_try_acquire_write (struct rwlock *);
+void rwlock_release_write (struct rwlock *);
+bool rwlock_upgrade (struct rwlock *);
+void rwlock_downgrade (struct rwlock *);
+bool rwlock_held_for_write (const struct rwlock *);
+
 /* Optimization barrier.
 
    The compiler will not reorder operations across an
@@ -17,7 +17,27 @@
 
 #include "copyright.h"
 #include "synchlist.h"
-#include "threads/malloc.h"
+#include <debug.h>
+#include "threads/slab.h"
+
+// Cache of the SL_elements that hold items appended with sl_append.
+static struct kmem_cache sl_element_cache;
+
+static void wait_for_room(struct SynchList *sl);
+static void push(struct SynchList *sl, struct list_elem *elem);
+static struct list_elem *pop(struct SynchList *sl);
+
+//----------------------------------------------------------------------
+// sl_cache_init
+//	Set up the cache that SL_elements are allocated from.  Called
+//	once at startup, before any list is used.
+//----------------------------------------------------------------------
+
+void sl_cache_init(void)
+{
+  kmem_cache_init(&sl_element_cache, "SL_element",
+                  sizeof(struct SL_element), NULL);
+}
 
 //----------------------------------------------------------------------
 // SynchList::SynchList
@@ -27,16 +47,33 @@
 //----------------------------------------------------------------------
 
 void sl_init(struct SynchList *sl)
+{
+  sl_init_bounded(sl, 0);
+}
+
+//----------------------------------------------------------------------
+// sl_init_bounded
+//	Like sl_init, but the list holds at most "capacity" elements,
+//	or is unbounded if "capacity" is 0: appending to a full list
+//	waits for a removal.
+//----------------------------------------------------------------------
+
+void sl_init_bounded(struct SynchList *sl, size_t capacity)
 {
   list_init(&sl->sl_list);
   lock_init(&sl->sl_lock);
   cond_init(&sl->sl_empty);
+  cond_init(&sl->sl_full);
+  sl->sl_count = 0;
+  sl->sl_capacity = capacity;
 }
 
 
 //----------------------------------------------------------------------
 // SynchList::~SynchList
-//	Remove and de-allocate all elements of the synchronized list
+//	Remove and de-allocate all elements of the synchronized list.
+//	Only for lists used with sl_append; intrusive elements
+//	belong to the caller, who must remove them first.
 //----------------------------------------------------------------------
 
 void sl_destroy(struct SynchList *sl)
@@ -46,8 +83,37 @@ void sl_destroy(struct SynchList *sl)
   while(!list_empty(&sl->sl_list)){
     e = list_pop_front(&sl->sl_list);
     sl_elem = list_entry(e, struct SL_element, elem);
-    free(sl_elem);
+    kmem_cache_free(&sl_element_cache, sl_elem);
   }
+  sl->sl_count = 0;
+}
+
+//----------------------------------------------------------------------
+// wait_for_room, push, pop
+//	Helpers that must be called with sl_lock held.  wait_for_room
+//	waits until the list is below its capacity; push and pop add
+//	and remove one element, waking one waiter on the other side.
+//----------------------------------------------------------------------
+
+static void wait_for_room(struct SynchList *sl)
+{
+  while (sl->sl_capacity != 0 && sl->sl_count >= sl->sl_capacity)
+    cond_wait(&sl->sl_full, &sl->sl_lock);
+}
+
+static void push(struct SynchList *sl, struct list_elem *elem)
+{
+  list_push_back(&sl->sl_list, elem);
+  sl->sl_count++;
+  cond_signal(&sl->sl_empty, &sl->sl_lock);  // wake up a waiter, if any
+}
+
+static struct list_elem *pop(struct SynchList *sl)
+{
+  sl->sl_count--;
+  if (sl->sl_capacity != 0)
+    cond_signal(&sl->sl_full, &sl->sl_lock);
+  return list_pop_front(&sl->sl_list);
 }
 
 
@@ -62,13 +128,10 @@ void sl_destroy(struct SynchList *sl)
 
 void sl_append(struct SynchList *sl, void *item)
 {
-  lock_acquire(&sl->sl_lock);                // enforce mutual exclusive access to the list 
-  struct SL_element *sl_elem = malloc(sizeof(struct SL_element));
+  struct SL_element *sl_elem = kmem_cache_alloc(&sl_element_cache);
+  ASSERT(sl_elem != NULL);
   sl_elem->item = item;
-  list_push_back(&sl->sl_list, &sl_elem->elem);
-  cond_signal(&sl->sl_empty,&sl->sl_lock);  // wake up a waiter, if any
-  lock_release(&sl->sl_lock);              
-  return;
+  sl_append_elem(sl, &sl_elem->elem);
 }
 
 
@@ -81,18 +144,124 @@ void sl_append(struct SynchList *sl, void *item)
 //----------------------------------------------------------------------
 
 void *sl_remove(struct SynchList *sl)
+{
+  struct list_elem *e = sl_remove_elem(sl);
+  struct SL_element *sl_elem = list_entry(e, struct SL_element, elem);
+  void *item = sl_elem->item;
+  kmem_cache_free(&sl_element_cache, sl_elem);
+  return item;
+}
+
+//----------------------------------------------------------------------
+// sl_append_elem
+//	Append "elem", embedded in the caller's item, to the end of
+//	the list, waiting for room if the list is full.
+//----------------------------------------------------------------------
+
+void sl_append_elem(struct SynchList *sl, struct list_elem *elem)
+{
+  lock_acquire(&sl->sl_lock);                // enforce mutual exclusive access to the list 
+  wait_for_room(sl);
+  push(sl, elem);
+  lock_release(&sl->sl_lock);
+}
+
+//----------------------------------------------------------------------
+// sl_remove_elem
+//	Remove and return the first element of the list, waiting
+//	until there is one.
+//----------------------------------------------------------------------
+
+struct list_elem *sl_remove_elem(struct SynchList *sl)
 {
   struct list_elem *e;
-  void *item;
   lock_acquire(&sl->sl_lock);                // enforce mutual exclusion
   while(list_empty(&sl->sl_list)){
     cond_wait(&sl->sl_empty, &sl->sl_lock);  // wait until list isn't empty
   }
-  e = list_pop_front(&sl->sl_list);
-  struct SL_element *sl_elem = list_entry(e, struct SL_element, elem);
-  item = sl_elem->item;
-  free(sl_elem);
+  e = pop(sl);
+  lock_release(&sl->sl_lock);
+  return e;
+}
+
+//----------------------------------------------------------------------
+// sl_try_remove
+//	Remove and return the first element of the list, or return a
+//	null pointer at once if the list is empty.
+//----------------------------------------------------------------------
+
+struct list_elem *sl_try_remove(struct SynchList *sl)
+{
+  struct list_elem *e = NULL;
+  lock_acquire(&sl->sl_lock);
+  if (!list_empty(&sl->sl_list))
+    e = pop(sl);
+  lock_release(&sl->sl_lock);
+  return e;
+}
+
+//----------------------------------------------------------------------
+// sl_append_many
+//	Move every element of "elems" to the end of the list, in
+//	order, taking the lock once rather than once per element.  If
+//	the list has a capacity, elements are moved in as many batches
+//	as the room allows, waiting for room between batches.
+//----------------------------------------------------------------------
+
+void sl_append_many(struct SynchList *sl, struct list *elems)
+{
+  lock_acquire(&sl->sl_lock);
+  while (!list_empty(elems)) {
+    struct list_elem *last = list_begin(elems);
+    size_t n = 0;
+
+    wait_for_room(sl);
+    while (last != list_end(elems)
+           && (sl->sl_capacity == 0 || sl->sl_count + n < sl->sl_capacity)) {
+      last = list_next(last);
+      n++;
+    }
+    list_splice(list_end(&sl->sl_list), list_begin(elems), last);
+    sl->sl_count += n;
+    if (n == 1)
+      cond_signal(&sl->sl_empty, &sl->sl_lock);
+    else
+      cond_broadcast(&sl->sl_empty, &sl->sl_lock);
+  }
   lock_release(&sl->sl_lock);
-  return item;
 }
 
+//----------------------------------------------------------------------
+// sl_remove_many
+//	Wait until the list is not empty, then move up to "max" of its
+//	first elements to the end of "elems", taking the lock once.
+// Returns:
+//	The number of elements moved, at least 1.
+//----------------------------------------------------------------------
+
+size_t sl_remove_many(struct SynchList *sl, struct list *elems, size_t max)
+{
+  struct list_elem *last;
+  size_t n = 0;
+
+  ASSERT(max > 0);
+  lock_acquire(&sl->sl_lock);
+  while(list_empty(&sl->sl_list)){
+    cond_wait(&sl->sl_empty, &sl->sl_lock);
+  }
+  last = list_begin(&sl->sl_list);
+  while (last != list_end(&sl->sl_list) && n < max) {
+    last = list_next(last);
+    n++;
+  }
+  list_splice(list_end(elems), list_begin(&sl->sl_list), last);
+  sl->sl_count -= n;
+  if (sl->sl_capacity != 0) {
+    if (n == 1)
+      cond_signal(&sl->sl_full, &sl->sl_lock);
+    else
+      cond_broadcast(&sl->sl_full, &sl->sl_lock);
+  }
+  lock_release(&sl->sl_lock);
+  return n;
+}
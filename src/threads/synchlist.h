@@ -21,10 +21,23 @@
 //	wait until the list has an element on it.
 //	2. One thread at a time can access list data structures
 
+//	3. If the list has a capacity, threads trying to append to a
+//	full list will wait until there is room.
+//
+// Items can be passed in two ways, which must not be mixed on one list:
+//	- by pointer, with sl_append and sl_remove, which wrap each
+//	  item in an SL_element allocated from a slab cache;
+//	- intrusively, with the *_elem, *_many and sl_try_remove
+//	  functions, which link a struct list_elem embedded in the
+//	  caller's item and so never allocate.
+
 struct SynchList {
   struct list sl_list;
   struct lock sl_lock;
-  struct condition sl_empty;
+  struct condition sl_empty;    // signaled when the list stops being empty
+  struct condition sl_full;     // signaled when a full list gets room
+  size_t sl_count;              // number of elements in sl_list
+  size_t sl_capacity;           // maximum sl_count, or 0 for no limit
 };
 
 struct SL_element
@@ -33,7 +46,15 @@ struct SL_element
   void *item;
 };
 
+void sl_cache_init(void);
 void sl_init(struct SynchList *sl);
+void sl_init_bounded(struct SynchList *sl, size_t capacity);
 void sl_destroy(struct SynchList *sl);
 void sl_append(struct SynchList *sl, void *item);
 void *sl_remove(struct SynchList *sl);
+
+void sl_append_elem(struct SynchList *sl, struct list_elem *elem);
+struct list_elem *sl_remove_elem(struct SynchList *sl);
+struct list_elem *sl_try_remove(struct SynchList *sl);
+void sl_append_many(struct SynchList *sl, struct list *elems);
+size_t sl_remove_many(struct SynchList *sl, struct list *elems, size_t max);
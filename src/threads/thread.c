@@ -10,7 +10,9 @@
 #include "threads/palloc.h"
 #include "threads/switch.h"
 #include "threads/synch.h"
+#include "threads/trace.h"
 #include "threads/vaddr.h"
+#include "devices/timer.h"
 #ifdef USERPROG
 #include "userprog/process.h"
 #endif
@@ -20,18 +22,65 @@
    of thread.h for details. */
 #define THREAD_MAGIC 0xcd6abf4b
 
-/* List of processes in THREAD_READY state, that is, processes
-   that are ready to run but not actually running. */
-static struct list ready_list;
+/* Number of distinct priority levels. */
+#define PRI_CNT (PRI_MAX - PRI_MIN + 1)
+#if PRI_CNT > 64
+#error ready_mask requires at most 64 priority levels
+#endif
+
+/* Run queues of processes in THREAD_READY state, that is,
+   processes that are ready to run but not actually running.
+   There is one FIFO queue per priority level, and bit P of
+   ready_mask is set if and only if ready_queues[P] is nonempty,
+   so that the highest-priority ready thread can be found with a
+   single find-last-set. */
+static struct list ready_queues[PRI_CNT];
+static uint64_t ready_mask;
+static int ready_cnt;           /* # of threads in all run queues. */
+
+/* List of all processes.  Processes are added to this list
+   when they are created and removed when they exit. */
+static struct list all_list;
 
 /* Idle thread. */
 static struct thread *idle_thread;
 
+/* Index of all live threads by tid, so that a thread can be
+   found without walking all_list.  It uses a fixed array of
+   buckets, so that it never calls malloc() and can be updated
+   with interrupts off, which protect it like all_list.  Threads
+   enter the index in thread_create() and leave it in
+   thread_exit(). */
+#define TID_BUCKET_CNT 64       /* Power of 2. */
+static struct list tid_buckets[TID_BUCKET_CNT];
+static struct hash tid_index;
+
 /* Initial thread, the thread running init.c:main(). */
 static struct thread *initial_thread;
 
-/* Lock used by allocate_tid(). */
-static struct lock tid_lock;
+/* Pages of dead threads kept for reuse by thread_create(), so
+   that creating a thread does not have to scan the page pool's
+   bitmap or clear a whole page.  Only the struct thread at the
+   bottom of a recycled page is cleared, by init_thread(); stale
+   data left in the stack area above it is harmless.  Accessed
+   with interrupts off. */
+#define PAGE_CACHE_MAX 16       /* Max. # of pages to keep. */
+static void *page_cache[PAGE_CACHE_MAX];
+static size_t page_cache_cnt;   /* # of pages in page_cache. */
+static long long page_cache_hits;   /* # of pages reused. */
+static long long page_cache_misses; /* # of pages from palloc. */
+
+/* A thread's accounting statistics, copied for printing by
+   thread_print_stats().  This is static rather than malloc()'d
+   because the statistics are also printed on a kernel panic. */
+#define USAGE_SNAPSHOT_MAX 64   /* Max. # of threads printed. */
+struct thread_usage
+  {
+    char name[16];              /* Thread name. */
+    tid_t tid;                  /* Thread identifier. */
+    struct rusage usage;        /* Statistics. */
+  };
+static struct thread_usage usage_snapshots[USAGE_SNAPSHOT_MAX];
 
 /* Stack frame for kernel_thread(). */
 struct kernel_thread_frame
@@ -55,6 +104,20 @@ static unsigned thread_ticks;   /* # of timer ticks since last yield. */
    Controlled by kernel command-line option "-o mlfqs". */
 bool thread_mlfqs;
 
+/* If true, time ready waits and wakeup latencies.
+   Controlled by kernel command-line option "-schedstat". */
+bool thread_schedstat;
+
+/* Multi-level feedback queue scheduler. */
+#define PRIORITY_FREQ 4         /* # of ticks between priority updates. */
+static fixed_t load_avg;        /* System load average. */
+
+/* Threads whose recent_cpu has been charged since the last
+   priority update.  Between the once-per-second updates of every
+   thread, only these threads' priorities can have changed, so
+   only they need to be recomputed every PRIORITY_FREQ ticks. */
+static struct list dirty_list;
+
 static void kernel_thread (thread_func *, void *aux);
 
 static void idle (void *aux UNUSED);
@@ -66,13 +129,26 @@ static void *alloc_frame (struct thread *, size_t size);
 static void schedule (void);
 void schedule_tail (struct thread *prev);
 static tid_t allocate_tid (void);
+static hash_hash_func tid_hash;
+static hash_less_func tid_less;
+static void tid_index_insert (struct thread *);
+static struct thread *alloc_thread_page (void);
+static void free_thread_page (struct thread *);
+static void account_switch (struct thread *cur, struct thread *next);
+static void print_thread_usage (const struct thread_usage *);
+static void ready_queue_push (struct thread *);
+static void ready_queue_remove (struct thread *);
+static void set_priority (struct thread *, int priority);
+static void mlfqs_tick (struct thread *);
+static int mlfqs_priority (const struct thread *);
+static int ready_max_priority (void);
 
 /* Initializes the threading system by transforming the code
    that's currently running into a thread.  This can't work in
    general and it is possible in this case only because loader.S
    was careful to put the bottom of the stack at a page boundary.
 
-   Also initializes the run queue and the tid lock.
+   Also initializes the run queues and the tid index.
 
    After calling this function, be sure to initialize the page
    allocator before trying to create any threads with
@@ -83,16 +159,25 @@ static tid_t allocate_tid (void);
 void
 thread_init (void)
 {
+  int i;
+
   ASSERT (intr_get_level () == INTR_OFF);
 
-  lock_init (&tid_lock);
-  list_init (&ready_list);
+  for (i = 0; i < PRI_CNT; i++)
+    list_init (&ready_queues[i]);
+  ready_mask = 0;
+  list_init (&all_list);
+  list_init (&dirty_list);
+  hash_init_fixed (&tid_index, tid_buckets, TID_BUCKET_CNT,
+                   tid_hash, tid_less, NULL);
 
   /* Set up a thread structure for the running thread. */
   initial_thread = running_thread ();
   init_thread (initial_thread, "main", PRI_DEFAULT);
   initial_thread->status = THREAD_RUNNING;
   initial_thread->tid = allocate_tid ();
+  tid_index_insert (initial_thread);
+  trace_thread (initial_thread->tid, initial_thread->name);
 }
 
 /* Starts preemptive thread scheduling by enabling interrupts.
@@ -100,8 +185,9 @@ thread_init (void)
 void
 thread_start (void)
 {
-  /* Create the idle thread. */
   struct semaphore idle_started;
+
+  /* Create the idle thread. */
   sema_init (&idle_started, 0);
   thread_create ("idle", PRI_MIN, idle, &idle_started);
 
@@ -128,6 +214,10 @@ thread_tick (void)
 #endif
   else
     kernel_ticks++;
+  t->usage.run_ticks++;
+
+  if (thread_mlfqs)
+    mlfqs_tick (t);
 
   /* Enforce preemption. */
   if (++thread_ticks >= TIME_SLICE)
@@ -138,8 +228,59 @@ thread_tick (void)
 void
 thread_print_stats (void)
 {
+  long long idle, kernel, user, hits, allocs;
+  enum intr_level old_level;
+  struct list_elem *e;
+  size_t thread_cnt, cnt, i;
+
+  /* Copy the statistics with interrupts off, then print them
+     with interrupts on, since printing to the console is slow. */
+  old_level = intr_disable ();
+  idle = idle_ticks;
+  kernel = kernel_ticks;
+  user = user_ticks;
+  hits = page_cache_hits;
+  allocs = page_cache_hits + page_cache_misses;
+  thread_cnt = list_size (&all_list);
+  cnt = 0;
+  for (e = list_begin (&all_list);
+       e != list_end (&all_list) && cnt < USAGE_SNAPSHOT_MAX;
+       e = list_next (e))
+    {
+      struct thread *t = list_entry (e, struct thread, allelem);
+      struct thread_usage *s = &usage_snapshots[cnt++];
+
+      strlcpy (s->name, t->name, sizeof s->name);
+      s->tid = t->tid;
+      thread_get_usage (t, &s->usage);
+    }
+  intr_set_level (old_level);
+
   printf ("Thread: %lld idle ticks, %lld kernel ticks, %lld user ticks\n",
-          idle_ticks, kernel_ticks, user_ticks);
+          idle, kernel, user);
+  printf ("Thread: %lld of %lld pages recycled (%lld%% hit rate)\n",
+          hits, allocs, allocs > 0 ? hits * 100 / allocs : 0);
+  for (i = 0; i < cnt; i++)
+    print_thread_usage (&usage_snapshots[i]);
+  if (thread_cnt > cnt)
+    printf ("Thread: %zu more threads not shown\n", thread_cnt - cnt);
+}
+
+/* Prints the accounting statistics in S.
+   Helper for thread_print_stats(). */
+static void
+print_thread_usage (const struct thread_usage *s)
+{
+  const struct rusage *u = &s->usage;
+
+  printf ("Thread %s (tid %d): %lld run ticks, %lld ready ticks, "
+          "%lld voluntary and %lld involuntary switches, %lld blocks, "
+          "%lld wakeups, wakeup latency avg %lld ns, max %lld ns\n",
+          s->name, s->tid, u->run_ticks, u->ready_ticks,
+          u->voluntary_switches, u->involuntary_switches, u->blocks,
+          u->wakeups,
+          u->wakeups > 0 ? u->wakeup_latency_ns / u->wakeups : 0,
+          u->wakeup_latency_max_ns);
 }
 
 /* Creates a new kernel thread named NAME with the given initial
@@ -154,9 +295,8 @@ thread_print_stats (void)
    scheduled.  Use a semaphore or some other form of
    synchronization if you need to ensure ordering.
 
-   The code provided sets the new thread's `priority' member to
-   PRIORITY, but no actual priority scheduling is implemented.
-   Priority scheduling is the goal of Problem 1-3. */
+   If the new thread has a higher priority than the running
+   thread, the running thread yields to it immediately. */
 tid_t
 thread_create (const char *name, int priority,
                thread_func *function, void *aux)
@@ -170,13 +310,15 @@ thread_create (const char *name, int priority,
   ASSERT (function != NULL);
 
   /* Allocate thread. */
-  t = palloc_get_page (PAL_ZERO);
+  t = alloc_thread_page ();
   if (t == NULL)
     return TID_ERROR;
 
   /* Initialize thread. */
   init_thread (t, name, priority);
   tid = t->tid = allocate_tid ();
+  trace_thread (tid, t->name);
+  tid_index_insert (t);
 
   /* Stack frame for kernel_thread(). */
   kf = alloc_frame (t, sizeof *kf);
@@ -194,6 +336,7 @@ thread_create (const char *name, int priority,
   //printf("Thread_create : %s\n", name); // EXECUTED
   /* Add to run queue. */
   thread_unblock (t);
+  thread_preempt ();
 
   return tid;
 }
@@ -211,6 +354,7 @@ thread_block (void)
   ASSERT (intr_get_level () == INTR_OFF);
 
   thread_current ()->status = THREAD_BLOCKED;
+  thread_current ()->usage.blocks++;
   schedule ();
 }
 
@@ -231,8 +375,15 @@ thread_unblock (struct thread *t)
 
   old_level = intr_disable ();
   ASSERT (t->status == THREAD_BLOCKED);
-  list_push_back (&ready_list, &t->elem);
+  ready_queue_push (t);
   t->status = THREAD_READY;
+  if (thread_schedstat)
+    {
+      t->ready_since = timer_nanotime ();
+      t->woken = true;
+    }
+  TRACE (TRACE_WAKEUP, t->tid,
+         intr_context () ? -1 : thread_current ()->tid, 0);
   intr_set_level (old_level);
 }
 
@@ -284,6 +435,10 @@ thread_exit (void)
   /* Just set our status to dying and schedule another process.
      We will be destroyed during the call to schedule_tail(). */
   intr_disable ();
+  list_remove (&thread_current ()->allelem);
+  hash_delete (&tid_index, &thread_current ()->tidelem.elem);
+  if (thread_current ()->cpu_dirty)
+    list_remove (&thread_current ()->dirtyelem);
   thread_current ()->status = THREAD_DYING;
   schedule ();
   NOT_REACHED ();
@@ -301,17 +456,114 @@ thread_yield (void)
 
   old_level = intr_disable ();
   if (cur != idle_thread)
-    list_push_back (&ready_list, &cur->elem);
+    {
+      ready_queue_push (cur);
+      if (thread_schedstat)
+        {
+          cur->ready_since = timer_nanotime ();
+          cur->woken = false;
+        }
+    }
   cur->status = THREAD_READY;
   schedule ();
   intr_set_level (old_level);
 }
 
-/* Sets the current thread's priority to NEW_PRIORITY. */
+/* Yields the CPU if some ready thread has a higher priority than
+   the running thread.  Within an interrupt handler, the yield is
+   deferred until the handler returns. */
+void
+thread_preempt (void)
+{
+  enum intr_level old_level = intr_disable ();
+  bool preempt = (ready_mask != 0
+                  && ready_max_priority () > thread_current ()->priority);
+  intr_set_level (old_level);
+
+  if (!preempt)
+    return;
+  if (intr_context ())
+    intr_yield_on_return ();
+  else
+    thread_yield ();
+}
+
+/* Sets the current thread's base priority to NEW_PRIORITY,
+   yielding at once if it is no longer the highest-priority
+   thread.  While the thread holds a lock that a higher-priority
+   thread is waiting for, its effective priority stays at the
+   donated level until the lock is released.
+
+   Ignored by the multi-level feedback queue scheduler, which
+   computes priorities itself. */
 void
 thread_set_priority (int new_priority)
 {
-  thread_current ()->priority = new_priority;
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
+
+  ASSERT (PRI_MIN <= new_priority && new_priority <= PRI_MAX);
+
+  if (thread_mlfqs)
+    return;
+
+  old_level = intr_disable ();
+  cur->base_priority = new_priority;
+  thread_update_priority (cur);
+  intr_set_level (old_level);
+
+  thread_preempt ();
+}
+
+/* Raises T's effective priority to PRIORITY, if that is higher
+   than its current effective priority.  Used by lock_acquire()
+   to donate the waiter's priority to a lock holder.  Does not
+   preempt the running thread. */
+void
+thread_donate_priority (struct thread *t, int priority)
+{
+  ASSERT (is_thread (t));
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (!thread_mlfqs && priority > t->priority)
+    set_priority (t, priority);
+}
+
+/* Recomputes T's effective priority as the maximum of its base
+   priority and the priorities of all the threads waiting for
+   locks that T holds.  Used when T releases a lock or changes
+   its base priority, to unwind donations that no longer apply.
+   Does not preempt the running thread. */
+void
+thread_update_priority (struct thread *t)
+{
+  struct list_elem *le, *we;
+  int priority;
+
+  ASSERT (is_thread (t));
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (thread_mlfqs)
+    return;
+
+  priority = t->base_priority;
+  for (le = list_begin (&t->held_locks); le != list_end (&t->held_locks);
+       le = list_next (le))
+    {
+      struct lock *lock = list_entry (le, struct lock, elem);
+      struct list *waiters = &lock->semaphore.waiters;
+
+      for (we = list_begin (waiters); we != list_end (waiters);
+           we = list_next (we))
+        {
+          struct thread *waiter = list_entry (we, struct thread, elem);
+          if (waiter->priority > priority)
+            priority = waiter->priority;
+        }
+    }
+
+  if (priority != t->priority)
+    set_priority (t, priority);
 }
 
 /* Returns the current thread's priority. */
@@ -321,35 +573,144 @@ thread_get_priority (void)
   return thread_current ()->priority;
 }
 
-/* Sets the current thread's nice value to NICE. */
+/* Sets the current thread's nice value to NICE, recalculates
+   its priority, and yields if it is no longer the
+   highest-priority thread. */
 void
-thread_set_nice (int nice UNUSED)
+thread_set_nice (int nice)
 {
-  /* Not yet implemented. */
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
+
+  if (nice < NICE_MIN)
+    nice = NICE_MIN;
+  else if (nice > NICE_MAX)
+    nice = NICE_MAX;
+
+  old_level = intr_disable ();
+  cur->nice = nice;
+  if (thread_mlfqs)
+    set_priority (cur, mlfqs_priority (cur));
+  intr_set_level (old_level);
+
+  thread_preempt ();
 }
 
 /* Returns the current thread's nice value. */
 int
 thread_get_nice (void)
 {
-  /* Not yet implemented. */
-  return 0;
+  return thread_current ()->nice;
 }
 
 /* Returns 100 times the system load average. */
 int
 thread_get_load_avg (void)
 {
-  /* Not yet implemented. */
-  return 0;
+  enum intr_level old_level = intr_disable ();
+  int load_avg_100 = fp_round (fp_mul_int (load_avg, 100));
+  intr_set_level (old_level);
+
+  return load_avg_100;
 }
 
 /* Returns 100 times the current thread's recent_cpu value. */
 int
 thread_get_recent_cpu (void)
 {
-  /* Not yet implemented. */
-  return 0;
+  enum intr_level old_level = intr_disable ();
+  int recent_cpu_100 = fp_round (fp_mul_int (thread_current ()->recent_cpu,
+                                             100));
+  intr_set_level (old_level);
+
+  return recent_cpu_100;
+}
+
+/* Performs the multi-level feedback queue scheduler's
+   bookkeeping for timer tick, with T the running thread.
+
+   T is charged one tick of recent_cpu.  Once per second,
+   load_avg and every thread's recent_cpu and priority are
+   recalculated.  Every PRIORITY_FREQ ticks in between, only the
+   threads that ran since the last update have their priority
+   recalculated, since no other thread's inputs have changed.
+   This keeps the per-tick cost independent of the number of
+   threads except for once a second. */
+static void
+mlfqs_tick (struct thread *t)
+{
+  int64_t ticks = timer_ticks ();
+
+  ASSERT (intr_context ());
+
+  if (t != idle_thread)
+    {
+      t->recent_cpu = fp_add_int (t->recent_cpu, 1);
+      if (!t->cpu_dirty)
+        {
+          t->cpu_dirty = true;
+          list_push_back (&dirty_list, &t->dirtyelem);
+        }
+    }
+
+  if (ticks % TIMER_FREQ == 0)
+    {
+      struct list_elem *e;
+      int ready_threads = ready_cnt + (t != idle_thread);
+      fixed_t decay;
+
+      load_avg = fp_add (fp_div_int (fp_mul_int (load_avg, 59), 60),
+                         fp_div_int (fp_from_int (ready_threads), 60));
+      decay = fp_div (fp_mul_int (load_avg, 2),
+                      fp_add_int (fp_mul_int (load_avg, 2), 1));
+
+      for (e = list_begin (&all_list); e != list_end (&all_list);
+           e = list_next (e))
+        {
+          struct thread *u = list_entry (e, struct thread, allelem);
+          if (u == idle_thread)
+            continue;
+          u->recent_cpu = fp_add_int (fp_mul (decay, u->recent_cpu),
+                                      u->nice);
+          set_priority (u, mlfqs_priority (u));
+        }
+    }
+  else if (ticks % PRIORITY_FREQ == 0)
+    {
+      struct list_elem *e;
+
+      for (e = list_begin (&dirty_list); e != list_end (&dirty_list);
+           e = list_next (e))
+        {
+          struct thread *u = list_entry (e, struct thread, dirtyelem);
+          set_priority (u, mlfqs_priority (u));
+        }
+    }
+  else
+    return;
+
+  while (!list_empty (&dirty_list))
+    list_entry (list_pop_front (&dirty_list), struct thread,
+                dirtyelem)->cpu_dirty = false;
+  thread_preempt ();
+}
+
+/* Returns the priority that the multi-level feedback queue
+   scheduler assigns to T, given its recent_cpu and nice value:
+   PRI_MAX - (recent_cpu / 4) - (nice * 2), clamped to the valid
+   range. */
+static int
+mlfqs_priority (const struct thread *t)
+{
+  int priority = fp_trunc (fp_sub (fp_from_int (PRI_MAX - t->nice * 2),
+                                   fp_div_int (t->recent_cpu, 4)));
+
+  if (priority < PRI_MIN)
+    return PRI_MIN;
+  else if (priority > PRI_MAX)
+    return PRI_MAX;
+  else
+    return priority;
 }
 
 /* Idle thread.  Executes when no other thread is ready to run.
@@ -374,6 +735,20 @@ idle (void *idle_started_ UNUSED)
       intr_disable ();
       thread_block ();
 
+      /* Nothing else wants to run.  Zero a free page for a later
+         PAL_ZERO allocation, then check again, since a thread may
+         have become ready while interrupts were on. */
+      intr_enable ();
+      if (palloc_zero_idle ())
+        continue;
+      intr_disable ();
+      if (ready_cnt > 0)
+        continue;
+
+      /* With dynamic ticks, stop the periodic timer interrupt
+         until the next timer deadline. */
+      timer_idle_enter ();
+
       /* Re-enable interrupts and wait for the next one.
 
          The `sti' instruction disables interrupts until the
@@ -427,17 +802,40 @@ is_thread (struct thread *t)
 static void
 init_thread (struct thread *t, const char *name, int priority)
 {
+  struct thread *parent = running_thread ();
+  int nice = NICE_DEFAULT;
+  fixed_t recent_cpu = 0;
+  enum intr_level old_level;
+
   ASSERT (t != NULL);
   ASSERT (PRI_MIN <= priority && priority <= PRI_MAX);
   ASSERT (name != NULL);
 
+  /* A new thread inherits its creator's nice and recent_cpu. */
+  if (t != parent)
+    {
+      nice = parent->nice;
+      recent_cpu = parent->recent_cpu;
+    }
+
   memset (t, 0, sizeof *t);
   t->status = THREAD_BLOCKED;
   strlcpy (t->name, name, sizeof t->name);
   t->stack = (uint8_t *) t + PGSIZE;
-  t->priority = priority;
+  t->nice = nice;
+  t->recent_cpu = recent_cpu;
+  if (thread_mlfqs)
+    priority = mlfqs_priority (t);
+  t->priority = t->base_priority = priority;
+  list_init (&t->held_locks);
+  t->waiting_lock = NULL;
+  t->ready_since = -1;
   t->magic = THREAD_MAGIC;
 
+  old_level = intr_disable ();
+  list_push_back (&all_list, &t->allelem);
+  intr_set_level (old_level);
+
   #ifdef USERPROG
   // We initializa all the values to NULL, will be used to know if the file is opend
   for (int i = 0; i < MAX_FILES + NB_RESERVED_FILES; ++i)
@@ -464,18 +862,97 @@ alloc_frame (struct thread *t, size_t size)
   return t->stack;
 }
 
+/* Appends T, which must be about to enter the THREAD_READY
+   state, to the run queue for its priority. */
+static void
+ready_queue_push (struct thread *t)
+{
+  int level = t->priority - PRI_MIN;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  list_push_back (&ready_queues[level], &t->elem);
+  ready_mask |= (uint64_t) 1 << level;
+  ready_cnt++;
+}
+
+/* Removes T, which must be in the THREAD_READY state, from its
+   run queue. */
+static void
+ready_queue_remove (struct thread *t)
+{
+  int level = t->priority - PRI_MIN;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (t->status == THREAD_READY);
+
+  list_remove (&t->elem);
+  if (list_empty (&ready_queues[level]))
+    ready_mask &= ~((uint64_t) 1 << level);
+  ready_cnt--;
+}
+
+/* Sets T's effective priority to PRIORITY, moving T to the
+   matching run queue if it is ready to run. */
+static void
+set_priority (struct thread *t, int priority)
+{
+  ASSERT (PRI_MIN <= priority && priority <= PRI_MAX);
+
+  if (t->status == THREAD_READY)
+    {
+      ready_queue_remove (t);
+      t->priority = priority;
+      ready_queue_push (t);
+    }
+  else
+    t->priority = priority;
+}
+
+/* Returns the priority of the highest-priority nonempty run
+   queue.  At least one run queue must be nonempty. */
+static int
+ready_max_priority (void)
+{
+  uint32_t high = ready_mask >> 32;
+  uint32_t low = ready_mask;
+
+  ASSERT (ready_mask != 0);
+
+  /* __builtin_clz() on each 32-bit half compiles to a BSR
+     instruction, avoiding a libgcc call for the 64-bit form. */
+  if (high != 0)
+    return PRI_MIN + 63 - __builtin_clz (high);
+  else
+    return PRI_MIN + 31 - __builtin_clz (low);
+}
+
 /* Chooses and returns the next thread to be scheduled.  Should
    return a thread from the run queue, unless the run queue is
    empty.  (If the running thread can continue running, then it
    will be in the run queue.)  If the run queue is empty, return
-   idle_thread. */
+   idle_thread.
+
+   The thread chosen is the one at the front of the
+   highest-priority nonempty run queue, so threads of equal
+   priority are scheduled round-robin. */
 static struct thread *
 next_thread_to_run (void)
 {
-  if (list_empty (&ready_list))
+  struct list *queue;
+  struct thread *next;
+  int level;
+
+  if (ready_mask == 0)
     return idle_thread;
-  else
-    return list_entry (list_pop_front (&ready_list), struct thread, elem);
+
+  level = ready_max_priority () - PRI_MIN;
+  queue = &ready_queues[level];
+  next = list_entry (list_pop_front (queue), struct thread, elem);
+  if (list_empty (queue))
+    ready_mask &= ~((uint64_t) 1 << level);
+  ready_cnt--;
+  return next;
 }
 
 /* Completes a thread switch by activating the new thread's page
@@ -520,7 +997,7 @@ schedule_tail (struct thread *prev)
   if (prev != NULL && prev->status == THREAD_DYING && prev != initial_thread)
     {
       ASSERT (prev != cur);
-      palloc_free_page (prev);
+      free_thread_page (prev);
     }
 }
 
@@ -542,25 +1019,169 @@ schedule (void)
   ASSERT (cur->status != THREAD_RUNNING);
   ASSERT (is_thread (next));
 
+  account_switch (cur, next);
+  TRACE (TRACE_SWITCH, cur->tid, next->tid, cur->status);
   if (cur != next)
     prev = switch_threads (cur, next);
   schedule_tail (prev);
 }
 
-/* Returns a tid to use for a new thread. */
+/* Updates the accounting statistics of CUR and NEXT for a
+   switch from CUR to NEXT.  A switch counts as voluntary if CUR
+   is blocking or exiting, and as involuntary if CUR is still
+   ready to run, whether it was preempted or yielded.  NEXT's
+   wait to run is only timed with thread_schedstat. */
+static void
+account_switch (struct thread *cur, struct thread *next)
+{
+  if (cur != next)
+    {
+      if (cur->status == THREAD_READY)
+        cur->usage.involuntary_switches++;
+      else
+        cur->usage.voluntary_switches++;
+    }
+
+  if (next->ready_since >= 0)
+    {
+      int64_t wait = timer_nanotime () - next->ready_since;
+
+      next->ready_ns += wait;
+      if (next->woken)
+        {
+          next->usage.wakeups++;
+          next->usage.wakeup_latency_ns += wait;
+          if (wait > next->usage.wakeup_latency_max_ns)
+            next->usage.wakeup_latency_max_ns = wait;
+        }
+      next->ready_since = -1;
+    }
+}
+
+/* Stores the accounting statistics of thread T into *USAGE. */
+void
+thread_get_usage (struct thread *t, struct rusage *usage)
+{
+  enum intr_level old_level;
+
+  ASSERT (is_thread (t));
+
+  old_level = intr_disable ();
+  *usage = t->usage;
+  usage->ready_ticks = t->ready_ns * TIMER_FREQ / 1000000000;
+  intr_set_level (old_level);
+}
+
+/* Returns a page for a new thread, taken from page_cache if
+   possible, otherwise from the page allocator.  Returns a null
+   pointer if no page is available.  The caller must initialize
+   the struct thread at the bottom of the page with init_thread();
+   the rest of the page may contain garbage. */
+static struct thread *
+alloc_thread_page (void)
+{
+  struct thread *t = NULL;
+  enum intr_level old_level;
+
+  old_level = intr_disable ();
+  if (page_cache_cnt > 0)
+    {
+      t = page_cache[--page_cache_cnt];
+      page_cache_hits++;
+    }
+  intr_set_level (old_level);
+
+  if (t == NULL)
+    {
+      t = palloc_get_page (0);
+      if (t != NULL)
+        {
+          old_level = intr_disable ();
+          page_cache_misses++;
+          intr_set_level (old_level);
+        }
+    }
+  return t;
+}
+
+/* Releases the page of dead thread T, keeping it in page_cache
+   if there is room.  Must be called with interrupts off. */
+static void
+free_thread_page (struct thread *t)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  /* Clobber the magic number so that stale pointers to T are
+     caught by is_thread(). */
+  t->magic = 0;
+  if (page_cache_cnt < PAGE_CACHE_MAX)
+    page_cache[page_cache_cnt++] = t;
+  else
+    palloc_free_page (t);
+}
+
+/* Returns a tid to use for a new thread.  Uses an atomic
+   fetch-and-add, so it needs no lock and may be called with
+   interrupts in any state. */
 static tid_t
 allocate_tid (void)
 {
   static tid_t next_tid = 1;
-  tid_t tid;
 
-  lock_acquire (&tid_lock);
-  tid = next_tid++;
-  lock_release (&tid_lock);
+  return __sync_fetch_and_add (&next_tid, 1);
+}
 
-  return tid;
+/* Returns a hash value for the tid_elem containing E. */
+static unsigned
+tid_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  return hash_int (hash_entry (e, struct tid_elem, elem)->tid);
 }
-
+
+/* Returns true if the tid_elem containing A has a smaller tid
+   than the one containing B. */
+static bool
+tid_less (const struct hash_elem *a, const struct hash_elem *b,
+          void *aux UNUSED)
+{
+  return (hash_entry (a, struct tid_elem, elem)->tid
+          < hash_entry (b, struct tid_elem, elem)->tid);
+}
+
+/* Adds T, whose tid must be set, to tid_index. */
+static void
+tid_index_insert (struct thread *t)
+{
+  enum intr_level old_level;
+  struct hash_elem *old;
+
+  t->tidelem.tid = t->tid;
+  old_level = intr_disable ();
+  old = hash_insert (&tid_index, &t->tidelem.elem);
+  intr_set_level (old_level);
+  ASSERT (old == NULL);
+}
+
+/* Returns the live thread whose tid is TID, or a null pointer if
+   there is none.
+
+   Must be called with interrupts off.  A thread leaves the index
+   in thread_exit() with interrupts off, so the thread returned
+   cannot exit and be freed until the caller turns interrupts
+   back on or blocks; after that, the pointer must not be used. */
+struct thread *
+thread_lookup (tid_t tid)
+{
+  struct tid_elem key;
+  struct hash_elem *e;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  key.tid = tid;
+  e = hash_find (&tid_index, &key.elem);
+  return e != NULL ? hash_entry (e, struct thread, tidelem.elem) : NULL;
+}
+
 /* Offset of `stack' member within `struct thread'.
    Used by switch.S, which can't figure it out on its own. */
 uint32_t thread_stack_ofs = offsetof (struct thread, stack);
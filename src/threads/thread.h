@@ -2,8 +2,11 @@
 #define THREADS_THREAD_H
 
 #include <debug.h>
+#include <hash.h>
 #include <list.h>
+#include <rusage.h>
 #include <stdint.h>
+#include "threads/fixed-point.h"
 #include "threads/synch.h"
 
 /* States in a thread's life cycle. */
@@ -25,6 +28,12 @@ typedef int tid_t;
 #define PRI_DEFAULT 31                  /* Default priority. */
 #define PRI_MAX 63                      /* Highest priority. */
 
+/* Thread nice values, for the multi-level feedback queue
+   scheduler. */
+#define NICE_MIN -20                    /* Nicest to other threads. */
+#define NICE_DEFAULT 0                  /* Default nice value. */
+#define NICE_MAX 20                     /* Least nice to other threads. */
+
 #define MAX_FILES 128
 #define NB_RESERVED_FILES 2
 /* A kernel thread or user process.
@@ -83,6 +92,15 @@ typedef int tid_t;
    only because they are mutually exclusive: only a thread in the
    ready state is on the run queue, whereas only a thread in the
    blocked state is on a semaphore wait list. */
+/* An entry in thread.c's index of live threads by tid.  A
+   lookup uses a bare one as its key, rather than a whole struct
+   thread. */
+struct tid_elem
+  {
+    tid_t tid;                          /* Copy of the thread's tid. */
+    struct hash_elem elem;              /* Hash table element. */
+  };
+
 struct thread
   {
     /* Owned by thread.c. */
@@ -90,9 +108,27 @@ struct thread
     enum thread_status status;          /* Thread state. */
     char name[16];                      /* Name (for debugging purposes). */
     uint8_t *stack;                     /* Saved stack pointer. */
-    int priority;                       /* Priority. */
+    int priority;                       /* Effective priority. */
+    int base_priority;                  /* Priority before donation. */
+
+    struct list_elem allelem;           /* List element for all threads list. */
+    struct tid_elem tidelem;            /* Entry in the index by tid. */
+
+    /* Multi-level feedback queue scheduler, owned by thread.c. */
+    int nice;                           /* Niceness. */
+    fixed_t recent_cpu;                 /* Recent CPU time received. */
+    bool cpu_dirty;                     /* On dirty_list? */
+    struct list_elem dirtyelem;         /* List element for dirty_list. */
+
+    /* Accounting, owned by thread.c. */
+    struct rusage usage;                /* CPU and scheduling statistics. */
+    int64_t ready_ns;                   /* Total ns spent ready to run. */
+    int64_t ready_since;                /* When made ready, or -1. */
+    bool woken;                         /* Made ready by thread_unblock()? */
 
     /* Shared between thread.c and synch.c. */
+    struct list held_locks;             /* Locks held, for donation. */
+    struct lock *waiting_lock;          /* Lock being waited for. */
     struct list_elem elem;              /* List element. */
 
 #ifdef USERPROG
@@ -110,16 +146,17 @@ struct thread
     unsigned magic;                     /* Detects stack overflow. */
   };
 
-struct sleepthread {
-  struct list_elem elem;
-  struct semaphore sema_value;
-  int64_t time_of_wake;
-};
 /* If false (default), use round-robin scheduler.
    If true, use multi-level feedback queue scheduler.
    Controlled by kernel command-line option "-o mlfqs". */
 extern bool thread_mlfqs;
 
+/* If true, time how long threads wait to run, for
+   thread_get_usage(), at the cost of reading the timer on every
+   wakeup and switch.
+   Controlled by kernel command-line option "-schedstat". */
+extern bool thread_schedstat;
+
 void thread_init (void);
 void thread_start (void);
 
@@ -134,13 +171,18 @@ void thread_unblock (struct thread *);
 
 struct thread *thread_current (void);
 tid_t thread_tid (void);
+void thread_get_usage (struct thread *, struct rusage *);
+struct thread *thread_lookup (tid_t);
 const char *thread_name (void);
 
 void thread_exit (void) NO_RETURN;
 void thread_yield (void);
+void thread_preempt (void);
 
 int thread_get_priority (void);
 void thread_set_priority (int);
+void thread_donate_priority (struct thread *, int priority);
+void thread_update_priority (struct thread *);
 
 int thread_get_nice (void);
 void thread_set_nice (int);
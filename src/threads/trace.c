@@ -0,0 +1,131 @@
+#include "threads/trace.h"
+#include <debug.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/interrupt.h"
+#include "threads/palloc.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "devices/serial.h"
+#include "devices/timer.h"
+
+/* If true, record trace events.
+   Controlled by kernel command-line option "-trace". */
+bool trace_enabled;
+
+/* A trace event. */
+struct trace_event
+  {
+    int64_t ns;                 /* timer_nanotime() of the event. */
+    int a, b;                   /* Type-specific, see trace.h. */
+    uint8_t type;               /* An enum trace_type. */
+    uint8_t arg;                /* Type-specific, see trace.h. */
+  };
+
+/* The ring buffer, allocated by trace_init().  Event number N
+   is stored in trace_buf[N % TRACE_CNT]. */
+#define TRACE_PAGES 16
+#define TRACE_CNT (TRACE_PAGES * PGSIZE / sizeof (struct trace_event))
+static struct trace_event *trace_buf;
+static unsigned trace_next;     /* Number of events recorded. */
+
+/* Names of the most recently created threads, indexed by tid
+   modulo TRACE_NAME_CNT, so that the dump can name threads that
+   have already exited. */
+#define TRACE_NAME_CNT 128
+struct trace_name
+  {
+    int tid;                    /* Thread's tid, or 0 if unused. */
+    char name[16];              /* Thread's name. */
+  };
+static struct trace_name trace_names[TRACE_NAME_CNT];
+
+/* Allocates the trace buffer, if tracing is enabled.  Events
+   before this call are not recorded. */
+void
+trace_init (void)
+{
+  if (trace_enabled)
+    trace_buf = palloc_get_multiple (PAL_ASSERT, TRACE_PAGES);
+}
+
+/* Records an event of TYPE with fields A, B, and ARG.  Use the
+   TRACE macro instead of calling this directly.
+
+   This function may be called from an interrupt handler. */
+void
+trace_record (enum trace_type type, int a, int b, int arg)
+{
+  enum intr_level old_level;
+  struct trace_event *e;
+
+  if (trace_buf == NULL)
+    return;
+
+  old_level = intr_disable ();
+  e = &trace_buf[trace_next++ % TRACE_CNT];
+  e->ns = timer_nanotime ();
+  e->a = a;
+  e->b = b;
+  e->type = type;
+  e->arg = arg;
+  intr_set_level (old_level);
+}
+
+/* Records that thread TID is called NAME. */
+void
+trace_thread (int tid, const char *name)
+{
+  struct trace_name *n;
+
+  if (!trace_enabled)
+    return;
+
+  n = &trace_names[tid % TRACE_NAME_CNT];
+  n->tid = tid;
+  strlcpy (n->name, name, sizeof n->name);
+}
+
+/* Writes the recorded events to the serial port, oldest first,
+   one per line, for utils/trace2json. */
+void
+trace_dump (void)
+{
+  static const char *reasons[] = {"run", "yield", "block", "exit"};
+  unsigned first, i;
+
+  if (trace_buf == NULL)
+    return;
+
+  first = trace_next > TRACE_CNT ? trace_next - TRACE_CNT : 0;
+  serial_printf ("Trace: %u events, %u lost\n",
+                 trace_next - first, first);
+  for (i = 0; i < TRACE_NAME_CNT; i++)
+    if (trace_names[i].tid != 0)
+      serial_printf ("Trace: thread %d %s\n",
+                     trace_names[i].tid, trace_names[i].name);
+
+  for (i = first; i != trace_next; i++)
+    {
+      const struct trace_event *e = &trace_buf[i % TRACE_CNT];
+
+      switch (e->type)
+        {
+        case TRACE_SWITCH:
+          serial_printf ("Trace: switch %lld %d %d %s\n", e->ns, e->a, e->b,
+                         e->arg < 4 ? reasons[e->arg] : "?");
+          break;
+        case TRACE_WAKEUP:
+          serial_printf ("Trace: wakeup %lld %d %d\n", e->ns, e->a, e->b);
+          break;
+        case TRACE_LOCK_BLOCK:
+          serial_printf ("Trace: block %lld %d %d\n", e->ns, e->a, e->b);
+          break;
+        case TRACE_INTR:
+          serial_printf ("Trace: intr %lld %d %d %s\n", e->ns, e->a, e->b,
+                         intr_name (e->a));
+          break;
+        }
+    }
+  serial_flush ();
+}
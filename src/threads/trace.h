@@ -0,0 +1,46 @@
+#ifndef THREADS_TRACE_H
+#define THREADS_TRACE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Scheduler event tracing.
+
+   When enabled by kernel command-line option "-trace", the
+   kernel records context switches, wakeups, lock blocks, and
+   interrupts in a fixed-size ring buffer, overwriting the oldest
+   events once it is full.  trace_dump() writes the buffer to the
+   serial port at shutdown; utils/trace2json converts that dump
+   into a Chrome trace for viewing as a timeline.
+
+   While tracing is disabled, each trace point costs a single
+   test of trace_enabled. */
+extern bool trace_enabled;
+
+/* Types of trace events, and the meaning of their A, B, and ARG
+   fields. */
+enum trace_type
+  {
+    TRACE_SWITCH,               /* A switched to B; ARG is A's new
+                                   enum thread_status. */
+    TRACE_WAKEUP,               /* A was made ready by B, or by an
+                                   interrupt handler if B is -1. */
+    TRACE_LOCK_BLOCK,           /* A blocked on a lock held by B. */
+    TRACE_INTR                  /* Interrupt A arrived while B ran. */
+  };
+
+/* Records an event of TYPE, if tracing is enabled. */
+#define TRACE(TYPE, A, B, ARG)                          \
+        do                                              \
+          {                                             \
+            if (trace_enabled)                          \
+              trace_record (TYPE, A, B, ARG);           \
+          }                                             \
+        while (0)
+
+void trace_init (void);
+void trace_record (enum trace_type, int a, int b, int arg);
+void trace_thread (int tid, const char *name);
+void trace_dump (void);
+
+#endif /* threads/trace.h */
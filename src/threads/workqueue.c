@@ -0,0 +1,321 @@
+#include "threads/workqueue.h"
+#include <debug.h>
+#include <list.h>
+#include <stdio.h>
+#include "threads/interrupt.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+/* Submitted work and its completion handle.  It is freed when
+   both the submitter (by workqueue_wait() or
+   workqueue_release()) and the pool are done with it. */
+struct work
+  {
+    struct list_elem elem;      /* Element in a worker's deque. */
+    work_func *func;            /* Function to run. */
+    void *aux;                  /* Auxiliary data for FUNC. */
+    bool queued;                /* In a deque, not yet started? */
+    bool done;                  /* Has FUNC returned? */
+    int refs;                   /* References held, at most 2. */
+    struct semaphore finished;  /* Upped when FUNC returns. */
+  };
+
+/* A worker thread and its deque of work.
+
+   The deques are only touched by deque_push(), take_work(),
+   workqueue_wait() and the idle handshake in worker_loop(), with
+   interrupts off.  On
+   a multiprocessor, each deque would get a spinlock of its own
+   instead. */
+struct worker
+  {
+    struct thread *thread;      /* The worker thread, once running. */
+    struct list deque;          /* Submitted work, next to run first. */
+    bool idle;                  /* Blocked waiting for work? */
+    long long executed;         /* Work items run. */
+    long long stolen;           /* ...of which taken from another deque. */
+  };
+
+int workqueue_workers = 2;
+
+static struct worker *workers;
+static int worker_cnt;
+static int next_worker;         /* Round-robin target for submissions. */
+static long long submitted;
+static long long run_by_waiters; /* Work run by workqueue_wait(). */
+
+static thread_func worker_loop;
+static struct worker *current_worker (void);
+static void deque_push (struct worker *, struct work *, bool front);
+static struct work *take_work (struct worker *);
+static bool work_queued (void);
+static void run_work (struct work *);
+static void put_work (struct work *);
+
+/* Starts the worker pool, with workqueue_workers threads.  Must
+   be called after thread_start(). */
+void
+workqueue_init (void)
+{
+  int i;
+
+  ASSERT (workers == NULL);
+
+  worker_cnt = workqueue_workers > 0 ? workqueue_workers : 1;
+  workers = calloc (worker_cnt, sizeof *workers);
+  if (workers == NULL)
+    PANIC ("cannot allocate %d workers", worker_cnt);
+
+  for (i = 0; i < worker_cnt; i++)
+    {
+      char name[24];
+
+      list_init (&workers[i].deque);
+      snprintf (name, sizeof name, "worker %d", i);
+      if (thread_create (name, PRI_DEFAULT, worker_loop, &workers[i])
+          == TID_ERROR)
+        PANIC ("cannot create %s", name);
+    }
+}
+
+/* Submits FUNC to be called with AUX by a worker thread.
+   Returns a handle that the caller must pass to either
+   workqueue_wait() or workqueue_release(), or a null pointer if
+   memory is short. */
+struct work *
+workqueue_submit (work_func *func, void *aux)
+{
+  struct worker *self;
+  struct work *w;
+
+  ASSERT (func != NULL);
+  ASSERT (workers != NULL);
+
+  w = malloc (sizeof *w);
+  if (w == NULL)
+    return NULL;
+  w->func = func;
+  w->aux = aux;
+  w->queued = true;
+  w->done = false;
+  w->refs = 2;
+  sema_init (&w->finished, 0);
+
+  self = current_worker ();
+  if (self != NULL)
+    deque_push (self, w, true);
+  else
+    deque_push (&workers[next_worker++ % worker_cnt], w, false);
+  return w;
+}
+
+/* Waits for the work W to finish, then releases it.
+
+   If no worker has started W yet, the caller runs it itself.
+   Work may thus wait for work it submitted without running the
+   pool out of threads. */
+void
+workqueue_wait (struct work *w)
+{
+  enum intr_level old_level;
+  bool run_here;
+
+  ASSERT (w != NULL);
+  ASSERT (!intr_context ());
+
+  old_level = intr_disable ();
+  run_here = w->queued;
+  if (run_here)
+    {
+      list_remove (&w->elem);
+      w->queued = false;
+      run_by_waiters++;
+    }
+  intr_set_level (old_level);
+
+  if (run_here)
+    run_work (w);
+  sema_down (&w->finished);
+  put_work (w);
+}
+
+/* Returns true if the work W has finished. */
+bool
+workqueue_done (const struct work *w)
+{
+  ASSERT (w != NULL);
+
+  return w->done;
+}
+
+/* Releases the handle W without waiting for the work to finish.
+   W may not be used afterward. */
+void
+workqueue_release (struct work *w)
+{
+  ASSERT (w != NULL);
+
+  put_work (w);
+}
+
+/* Prints worker pool statistics. */
+void
+workqueue_print_stats (void)
+{
+  int i;
+
+  if (workers == NULL)
+    return;
+
+  printf ("Workqueue: %lld items submitted to %d workers, "
+          "%lld run by waiters\n", submitted, worker_cnt, run_by_waiters);
+  for (i = 0; i < worker_cnt; i++)
+    printf ("Workqueue: worker %d: %lld run, %lld stolen\n",
+            i, workers[i].executed, workers[i].stolen);
+}
+
+/* Worker thread: runs work from its own deque, or stolen from
+   the others, blocking while there is none anywhere. */
+static void
+worker_loop (void *self_)
+{
+  struct worker *self = self_;
+
+  self->thread = thread_current ();
+  for (;;)
+    {
+      struct work *w = take_work (self);
+
+      if (w != NULL)
+        run_work (w);
+      else
+        {
+          /* Recheck with interrupts off, so that a submission
+             between the check and blocking cannot be missed. */
+          enum intr_level old_level = intr_disable ();
+          if (!work_queued ())
+            {
+              self->idle = true;
+              thread_block ();
+            }
+          intr_set_level (old_level);
+        }
+    }
+}
+
+/* Returns the worker running as the current thread, or a null
+   pointer if the current thread is not a worker. */
+static struct worker *
+current_worker (void)
+{
+  struct thread *cur = thread_current ();
+  int i;
+
+  for (i = 0; i < worker_cnt; i++)
+    if (workers[i].thread == cur)
+      return &workers[i];
+  return NULL;
+}
+
+/* Adds W to the deque of worker WK, at the front (to run next)
+   if FRONT is true, otherwise at the back.  Wakes WK if it is
+   idle, or else some other idle worker, which will steal W. */
+static void
+deque_push (struct worker *wk, struct work *w, bool front)
+{
+  enum intr_level old_level = intr_disable ();
+  int i;
+
+  if (front)
+    list_push_front (&wk->deque, &w->elem);
+  else
+    list_push_back (&wk->deque, &w->elem);
+  submitted++;
+
+  for (i = 0; i < worker_cnt && !wk->idle; i++)
+    wk = &workers[(wk - workers + 1) % worker_cnt];
+  if (wk->idle)
+    {
+      wk->idle = false;
+      thread_unblock (wk->thread);
+    }
+  intr_set_level (old_level);
+}
+
+/* Removes and returns the next work for worker SELF: the front
+   of its own deque, or else the back of the first non-empty
+   deque of another worker.  Returns a null pointer if every
+   deque is empty. */
+static struct work *
+take_work (struct worker *self)
+{
+  enum intr_level old_level = intr_disable ();
+  struct work *w = NULL;
+  int i;
+
+  if (!list_empty (&self->deque))
+    w = list_entry (list_pop_front (&self->deque), struct work, elem);
+  else
+    for (i = 1; i < worker_cnt; i++)
+      {
+        struct worker *victim = &workers[(self - workers + i) % worker_cnt];
+        if (!list_empty (&victim->deque))
+          {
+            w = list_entry (list_pop_back (&victim->deque),
+                            struct work, elem);
+            self->stolen++;
+            break;
+          }
+      }
+  if (w != NULL)
+    {
+      w->queued = false;
+      self->executed++;
+    }
+  intr_set_level (old_level);
+
+  return w;
+}
+
+/* Returns true if any worker's deque is non-empty.  Must be
+   called with interrupts off. */
+static bool
+work_queued (void)
+{
+  int i;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  for (i = 0; i < worker_cnt; i++)
+    if (!list_empty (&workers[i].deque))
+      return true;
+  return false;
+}
+
+/* Runs W and signals its completion. */
+static void
+run_work (struct work *w)
+{
+  enum intr_level old_level;
+
+  w->func (w->aux);
+
+  old_level = intr_disable ();
+  w->done = true;
+  sema_up (&w->finished);
+  intr_set_level (old_level);
+  put_work (w);
+}
+
+/* Drops a reference to W, freeing it when none remain. */
+static void
+put_work (struct work *w)
+{
+  enum intr_level old_level = intr_disable ();
+  bool last = --w->refs == 0;
+  intr_set_level (old_level);
+
+  if (last)
+    free (w);
+}
@@ -0,0 +1,35 @@
+#ifndef THREADS_WORKQUEUE_H
+#define THREADS_WORKQUEUE_H
+
+#include <stdbool.h>
+
+/* Kernel worker pool.
+
+   Background work (flushing, read-ahead, page zeroing, ...) is
+   submitted with workqueue_submit() and run by a fixed pool of
+   kernel threads instead of a thread of its own.  Each worker
+   has a local deque of submitted work: it takes its own work
+   from the front and, when that runs dry, steals from the back
+   of the other workers' deques.  Work submitted by a work
+   function goes to the front of its own worker's deque, so it
+   tends to run soon, on the same worker; other submissions are
+   spread over the workers round-robin. */
+
+/* Number of worker threads.  Controlled by kernel command-line
+   option "-workers=N". */
+extern int workqueue_workers;
+
+/* A function run by the pool. */
+typedef void work_func (void *aux);
+
+/* Completion handle for submitted work. */
+struct work;
+
+void workqueue_init (void);
+struct work *workqueue_submit (work_func *, void *aux);
+void workqueue_wait (struct work *);
+bool workqueue_done (const struct work *);
+void workqueue_release (struct work *);
+void workqueue_print_stats (void);
+
+#endif /* threads/workqueue.h */
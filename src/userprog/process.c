@@ -15,7 +15,7 @@
 #include "threads/init.h"
 #include "threads/interrupt.h"
 #include "threads/palloc.h"
-#include "threads/malloc.h"
+#include "threads/slab.h"
 #include "threads/thread.h"
 #include "threads/vaddr.h"
 
@@ -23,6 +23,27 @@ static thread_func start_process NO_RETURN;
 static bool load (const char *cmdline, void (**eip) (void), void **esp);
 int free_parent_child_pair(struct parent_child* p_c);
 
+/* Cache of parent_child pairs. */
+static struct kmem_cache parent_child_cache;
+
+/* Constructs a parent_child pair in PAIR_.  A pair's alive_lock
+   is released by the time the pair is freed, so it only needs
+   to be initialized once. */
+static void
+parent_child_ctor (void *pair_)
+{
+  struct parent_child *pair = pair_;
+  lock_init (&pair->alive_lock);
+}
+
+/* Initializes the process module. */
+void
+process_init (void)
+{
+  kmem_cache_init (&parent_child_cache, "parent_child",
+                   sizeof (struct parent_child), parent_child_ctor);
+}
+
 /* Starts a new thread running a user program loaded from
    FILENAME.  The new thread may be scheduled (and may even exit)
    before process_execute() returns.  Returns the new process's
@@ -41,15 +62,19 @@ process_execute (const char *file_name)
   strlcpy (fn_copy, file_name, PGSIZE);
 
   // Initialize a struct we argument we want to use between the child and the parent
-  struct parent_child* sync = malloc(sizeof(struct parent_child));
+  struct parent_child* sync = kmem_cache_alloc(&parent_child_cache);
+  if (sync == NULL)
+  {
+    palloc_free_page (fn_copy);
+    return TID_ERROR;
+  }
 
   sema_init(&sync->sema, 0); // a semaphore for the wait
   sync->file_name = fn_copy; // The program name
   sync->success = true; // The return value of start_process
   sync->alive_count = 2; // Count to know who must free ressources
   sync->has_already_wait = false; // used to check that wait isn't called twice
-
-  lock_init(&sync->alive_lock); // A lock to provide sync to alive_count
+  // alive_lock, which provides sync to alive_count, is set up by the cache
 
   /* Create a new thread to execute FILE_NAME. */
   tid = thread_create (file_name, PRI_DEFAULT, start_process, sync);
@@ -71,7 +96,7 @@ process_execute (const char *file_name)
   // if program didn't run, return -1
   if (!success)
   {
-      free(sync);
+      kmem_cache_free(&parent_child_cache, sync);
       return -1;
   }
 
@@ -180,7 +205,7 @@ int free_parent_child_pair(struct parent_child* p_c)
     if (p_c->alive_count == 0) // In that case we need to free ressources
     {
       lock_release(&p_c->alive_lock);
-      free(p_c);
+      kmem_cache_free(&parent_child_cache, p_c);
       return 1;
     }
     lock_release(&p_c->alive_lock);
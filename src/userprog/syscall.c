@@ -1,6 +1,7 @@
 #include "userprog/syscall.h"
 #include "userprog/process.h"
 #include "userprog/pagedir.h"
+#include <hash.h>
 #include <stdio.h>
 #include <syscall-nr.h>
 #include "threads/interrupt.h"
@@ -13,6 +14,20 @@
 #include "lib/kernel/stdio.h"
 #include "threads/vaddr.h"
 
+/* A thread blocked in futex_wait(). */
+struct futex_waiter
+  {
+    struct list_elem elem;      /* Element in a futex_queues bucket. */
+    const int *key;             /* Kernel address of the futex word. */
+    struct semaphore wakeup;    /* Upped by futex_wake(). */
+  };
+
+/* Threads blocked in futex_wait(), hashed by the kernel virtual
+   address of the word they wait on.  That address identifies the
+   physical frame, so it stays valid however the word is mapped.
+   Accessed with interrupts off. */
+#define FUTEX_BUCKET_CNT 64
+static struct list futex_queues[FUTEX_BUCKET_CNT];
 
 static void syscall_handler (struct intr_frame *);
 bool valid_pointer(void* ptr);
@@ -21,9 +36,17 @@ void valid_buffer(void* ptr, unsigned buf_size);
 void* incr_and_check(void* ptr);
 void exit(int exit_value);
 int filesize(int fd);
+static const int *futex_key (const int *uaddr);
+static struct list *futex_bucket (const int *key);
+static int futex_wait (const int *uaddr, int expected);
+static int futex_wake (const int *uaddr, int n);
 void
 syscall_init (void)
 {
+  int i;
+
+  for (i = 0; i < FUTEX_BUCKET_CNT; i++)
+    list_init (&futex_queues[i]);
   intr_register_int (0x30, 3, INTR_ON, syscall_handler, "syscall");
 }
 // Check for the validity of a pointer (< PHYS_BASE and in the pagedir)
@@ -322,6 +345,104 @@ syscall_handler (struct intr_frame *f UNUSED)
       valid_string(file_name);
       f->eax = filesys_remove(file_name);
   }
+  else if (*user_stack == SYS_GETRUSAGE)
+  {
+      // Copy the calling thread's statistics to the user's struct,
+      // which may straddle a page boundary
+      user_stack = incr_and_check(user_stack);
+      struct rusage* usage = (struct rusage*)*user_stack;
+      if (!valid_pointer(usage) || !valid_pointer((char*)(usage + 1) - 1))
+          exit(-1);
+
+      thread_get_usage(thread_current(), usage);
+  }
+  else if (*user_stack == SYS_FUTEX_WAIT)
+  {
+      user_stack = incr_and_check(user_stack);
+      const int* addr = (const int*)*user_stack;
+      user_stack = incr_and_check(user_stack);
+      int expected = *user_stack;
+      f->eax = futex_wait(addr, expected);
+  }
+  else if (*user_stack == SYS_FUTEX_WAKE)
+  {
+      user_stack = incr_and_check(user_stack);
+      const int* addr = (const int*)*user_stack;
+      user_stack = incr_and_check(user_stack);
+      int n = *user_stack;
+      f->eax = futex_wake(addr, n);
+  }
+}
+
+/* Returns the kernel address of the futex word at user address
+   UADDR, killing the process if UADDR is unmapped or misaligned.
+   A word-aligned int cannot straddle a page boundary. */
+static const int *
+futex_key (const int *uaddr)
+{
+  if ((uintptr_t) uaddr % sizeof *uaddr != 0 || !valid_pointer((void*)uaddr))
+    exit(-1);
+  return pagedir_get_page (thread_current ()->pagedir, uaddr);
+}
+
+/* Returns the wait queue for futex word KEY. */
+static struct list *
+futex_bucket (const int *key)
+{
+  return &futex_queues[hash_int ((uintptr_t) key) % FUTEX_BUCKET_CNT];
+}
+
+/* If the word at user address UADDR still holds EXPECTED, sleeps
+   until futex_wake() is called on it and returns 0.  Otherwise,
+   returns -1 at once.  The comparison and going to sleep are
+   atomic with respect to futex_wake(), so a wakeup sent after the
+   caller changed the word cannot be lost. */
+static int
+futex_wait (const int *uaddr, int expected)
+{
+  const int *key = futex_key (uaddr);
+  struct futex_waiter w;
+  enum intr_level old_level;
+
+  old_level = intr_disable ();
+  if (*key != expected)
+    {
+      intr_set_level (old_level);
+      return -1;
+    }
+  w.key = key;
+  sema_init (&w.wakeup, 0);
+  list_push_back (futex_bucket (key), &w.elem);
+  sema_down (&w.wakeup);
+  intr_set_level (old_level);
+  return 0;
+}
+
+/* Wakes up to N threads waiting on the word at user address
+   UADDR, oldest first, and returns the number woken. */
+static int
+futex_wake (const int *uaddr, int n)
+{
+  const int *key = futex_key (uaddr);
+  struct list *bucket = futex_bucket (key);
+  struct list_elem *e;
+  enum intr_level old_level;
+  int woken = 0;
+
+  old_level = intr_disable ();
+  for (e = list_begin (bucket); e != list_end (bucket) && woken < n; )
+    {
+      struct futex_waiter *w = list_entry (e, struct futex_waiter, elem);
+      e = list_next (e);
+      if (w->key == key)
+        {
+          list_remove (&w->elem);
+          sema_up (&w->wakeup);
+          woken++;
+        }
+    }
+  intr_set_level (old_level);
+  return woken;
 }
 // I created a specific function for exit so it can be called by other function (incr_and_check, valid_string, ...)
 void exit(int exit_value)